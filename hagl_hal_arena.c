@@ -0,0 +1,160 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Back buffers and line buffers from caller supplied static arenas. Arena
+is a stack, only the most recent allocation can be freed. Allocations are
+aligned for word access and DMA and cannot fail late because of heap
+fragmentation. Buffers which do not fit fall back to the heap.
+
+*/
+
+#include "hagl_hal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAGL_HAL_USE_ARENA
+void
+hagl_hal_arena_init(hagl_hal_arena_t *arena, void *base, size_t size)
+{
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+    arena->count = 0;
+}
+
+void *
+hagl_hal_arena_alloc(hagl_hal_arena_t *arena, size_t size, size_t align)
+{
+    uintptr_t start = (uintptr_t) arena->base + arena->used;
+
+    /* Alignment must be a power of two. */
+    start = (start + align - 1) & ~(uintptr_t) (align - 1);
+
+    if (start + size > (uintptr_t) arena->base + arena->size) {
+        return NULL;
+    }
+
+    /* Allocation which could not be freed later would break the stack. */
+    if (arena->count == HAGL_HAL_ARENA_DEPTH) {
+        return NULL;
+    }
+
+    arena->start[arena->count++] = start - (uintptr_t) arena->base;
+    arena->used = start + size - (uintptr_t) arena->base;
+    memset((void *) start, 0, size);
+    return (void *) start;
+}
+
+/*
+ * Arena is a stack. Only the most recent allocation can be released,
+ * anything else would also release the buffers allocated after it.
+ */
+void
+hagl_hal_arena_free(hagl_hal_arena_t *arena, void *buffer)
+{
+    if (0 == arena->count) {
+        return;
+    }
+
+    size_t offset = (uintptr_t) buffer - (uintptr_t) arena->base;
+    if (offset == arena->start[arena->count - 1]) {
+        arena->used = offset;
+        arena->count--;
+    } else {
+        hagl_hal_debug("Buffer %p is not the most recent allocation, not freeing.\n", buffer);
+    }
+}
+
+bool
+hagl_hal_arena_owns(const hagl_hal_arena_t *arena, const void *buffer)
+{
+    uintptr_t address = (uintptr_t) buffer;
+    return arena && address >= (uintptr_t) arena->base && address < (uintptr_t) arena->base + arena->size;
+}
+
+/* Second back buffer comes from the second arena when there is one. */
+static hagl_hal_arena_t *
+hagl_hal_arena(mipi_display_config_t *display_config, uint8_t index)
+{
+    if (index && display_config->arena[1]) {
+        return display_config->arena[1];
+    }
+    return display_config->arena[0];
+}
+#endif /* HAGL_HAL_USE_ARENA */
+
+void *
+hagl_hal_buffer_calloc(mipi_display_config_t *display_config, uint8_t index, size_t size, void *(*fallback)(size_t, size_t))
+{
+#ifdef HAGL_HAL_USE_ARENA
+    hagl_hal_arena_t *arena = hagl_hal_arena(display_config, index);
+
+    if (arena) {
+        void *buffer = hagl_hal_arena_alloc(arena, size, HAGL_HAL_BUFFER_ALIGN);
+        if (buffer) {
+            return buffer;
+        }
+        hagl_hal_debug("Arena %p is full, allocating %d bytes from heap.\n", (void *) arena, (int) size);
+    }
+#else
+    (void) display_config;
+    (void) index;
+#endif /* HAGL_HAL_USE_ARENA */
+
+#ifdef HAGL_HAL_USE_RUNTIME_BUFFER
+    /* Buffers are freed with free() when buffering is switched. */
+    (void) fallback;
+    return calloc(size, sizeof(uint8_t));
+#else
+    return fallback(size, sizeof(uint8_t));
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
+}
+
+void
+hagl_hal_buffer_free(mipi_display_config_t *display_config, void *buffer)
+{
+#ifdef HAGL_HAL_USE_ARENA
+    for (uint8_t i = 0; i < 2; i++) {
+        if (hagl_hal_arena_owns(display_config->arena[i], buffer)) {
+            hagl_hal_arena_free(display_config->arena[i], buffer);
+            return;
+        }
+    }
+#else
+    (void) display_config;
+#endif /* HAGL_HAL_USE_ARENA */
+
+    free(buffer);
+}
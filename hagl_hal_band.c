@@ -0,0 +1,335 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+This is the backend when band buffering is enabled. Drawing operations
+are recorded during the frame. When flushing they are replayed once for
+each horizontal band of the display into a small band buffer which is
+then sent to the display. Two band buffers are used in turns so with DMA
+the next band is rendered while the previous one is being sent.
+
+Band buffers are cleared before rendering so each frame must be drawn
+from scratch. Reading pixels back is not supported.
+
+Note that all coordinates are already clipped in the main library itself.
+Backend does not need to validate the coordinates, they can always be
+assumed to be valid.
+
+*/
+
+#include "hagl_hal.h"
+
+#ifdef HAGL_HAL_USE_BAND_BUFFER
+
+#include <string.h>
+#include <hardware/gpio.h>
+#include <pico/time.h>
+#include <mipi_display.h>
+
+#include <hagl/backend.h>
+#include <hagl/bitmap.h>
+#include <hagl.h>
+
+#define HAGL_HAL_OP_FILL        (0)
+#define HAGL_HAL_OP_BLIT        (1)
+#define HAGL_HAL_OP_SCALE_BLIT  (2)
+
+static hagl_hal_op_t *
+op_add(mipi_display_config_t *display_config, uint8_t type, int16_t x0, int16_t y0, uint16_t w, uint16_t h)
+{
+    if (HAGL_HAL_BAND_OPS == display_config->op_count) {
+        hagl_hal_debug("Dropping operation, %d already recorded.\n", HAGL_HAL_BAND_OPS);
+        return NULL;
+    }
+
+    hagl_hal_op_t *op = &display_config->ops[display_config->op_count++];
+    op->type = type;
+    op->x0 = x0;
+    op->y0 = y0;
+    op->w = w;
+    op->h = h;
+
+    return op;
+}
+
+/*
+ * Fills continuing the previous one horizontally or vertically with the
+ * same color are merged into it. Text and filled shapes then take only a
+ * few operations.
+ */
+static void
+op_fill(mipi_display_config_t *display_config, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (display_config->op_count) {
+        hagl_hal_op_t *last = &display_config->ops[display_config->op_count - 1];
+
+        if (HAGL_HAL_OP_FILL == last->type && color == last->color) {
+            if (y0 == last->y0 && h == last->h && x0 == last->x0 + last->w) {
+                last->w += w;
+                return;
+            }
+            if (x0 == last->x0 && w == last->w && y0 == last->y0 + last->h) {
+                last->h += h;
+                return;
+            }
+        }
+    }
+
+    hagl_hal_op_t *op = op_add(display_config, HAGL_HAL_OP_FILL, x0, y0, w, h);
+    if (op) {
+        op->color = color;
+    }
+}
+
+static void
+op_bitmap(mipi_display_config_t *display_config, uint8_t type, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    uint32_t size = src->width * src->height;
+
+    if (display_config->op_pixel_count + size > HAGL_HAL_BAND_PIXELS) {
+        hagl_hal_debug("Dropping bitmap, no room for %d pixels.\n", (int) size);
+        return;
+    }
+
+    hagl_hal_op_t *op = op_add(display_config, type, x0, y0, w, h);
+    if (!op) {
+        return;
+    }
+
+    op->src_w = src->width;
+    op->src_h = src->height;
+    op->offset = display_config->op_pixel_count;
+
+    /* Copy row by row in case bitmap has padding. */
+    hagl_color_t *dst = &display_config->op_pixels[op->offset];
+    for (int16_t y = 0; y < src->height; y++) {
+        memcpy(dst, src->buffer + y * src->pitch, src->width * sizeof(hagl_color_t));
+        dst += src->width;
+    }
+
+    display_config->op_pixel_count += size;
+}
+
+/* Draw the part of the operation which falls inside the band. */
+static void
+op_render(mipi_display_config_t *display_config, hagl_hal_op_t *op, hagl_bitmap_t *band, int16_t band_y)
+{
+    int16_t y0 = op->y0 - band_y;
+    int16_t y1 = y0 + op->h - 1;
+
+    if (y1 < 0 || y0 >= band->height) {
+        return;
+    }
+
+    /* Rows of the operation inside the band. */
+    int16_t first = y0 < 0 ? -y0 : 0;
+    int16_t last = y1 >= band->height ? band->height - 1 - y0 : op->h - 1;
+
+    switch (op->type) {
+    case HAGL_HAL_OP_FILL:
+        if (1 == op->w) {
+            band->vline(band, op->x0, y0 + first, last - first + 1, op->color);
+        } else {
+            for (int16_t y = first; y <= last; y++) {
+                band->hline(band, op->x0, y0 + y, op->w, op->color);
+            }
+        }
+        break;
+    case HAGL_HAL_OP_BLIT:
+        for (int16_t y = first; y <= last; y++) {
+            memcpy(
+                band->buffer + (y0 + y) * band->pitch + op->x0 * sizeof(hagl_color_t),
+                &display_config->op_pixels[op->offset + y * op->src_w],
+                op->w * sizeof(hagl_color_t)
+            );
+        }
+        break;
+    case HAGL_HAL_OP_SCALE_BLIT: {
+        uint32_t x_ratio = (uint32_t)((op->src_w << 16) / op->w) + 1;
+        uint32_t y_ratio = (uint32_t)((op->src_h << 16) / op->h) + 1;
+        uint16_t width = op->w;
+
+        /* Scaled bitmaps are not clipped by HAGL. */
+        if (op->x0 + width > band->width) {
+            width = band->width - op->x0;
+        }
+
+        for (int16_t y = first; y <= last; y++) {
+            hagl_color_t *src = &display_config->op_pixels[op->offset + ((y * y_ratio) >> 16) * op->src_w];
+            hagl_color_t *dst = (hagl_color_t *) (band->buffer + (y0 + y) * band->pitch) + op->x0;
+            for (uint16_t x = 0; x < width; x++) {
+                dst[x] = src[(x * x_ratio) >> 16];
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static size_t
+flush(const void *self)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+    size_t sent = 0;
+    uint8_t current = 0;
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    /* Display stays in low power mode until something is drawn. */
+    if (0 == display_config->op_count) {
+        return 0;
+    }
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    uint64_t start = time_us_64();
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+    /* Last band of the previous frame might still be in flight. */
+    mipi_display_sync(display_config);
+
+    mipi_display_vblank_wait(display_config);
+
+    /* Bands are streamed into one window covering the whole display. */
+    mipi_display_start_xywh(display_config, 0, 0, display_config->width, display_config->height);
+
+    for (int16_t band_y = 0; band_y < display_config->height; band_y += HAGL_HAL_BAND_HEIGHT) {
+        hagl_bitmap_t *band = &display_config->band[current];
+        uint16_t height = HAGL_HAL_BAND_HEIGHT;
+
+        if (band_y + height > display_config->height) {
+            height = display_config->height - band_y;
+        }
+
+        memset(band->buffer, 0, band->size);
+        for (uint16_t i = 0; i < display_config->op_count; i++) {
+            op_render(display_config, &display_config->ops[i], band, band_y);
+        }
+
+        /* Waits for the previous band, which is in the other buffer. */
+        sent += mipi_display_write_stream(display_config, band->buffer, height * band->pitch);
+        current ^= 1;
+    }
+
+    display_config->op_count = 0;
+    display_config->op_pixel_count = 0;
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_flush(display_config, start);
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+    return sent;
+}
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+void
+hagl_hal_power_mode(hagl_backend_t *backend, uint8_t mode, const hagl_window_t *area)
+{
+    mipi_display_power_mode(GET_MIPI_DISPLAY_CONFIG(backend), mode, area);
+}
+
+void
+hagl_hal_power_time(hagl_backend_t *backend, uint64_t *time)
+{
+    mipi_display_power_time(GET_MIPI_DISPLAY_CONFIG(backend), time);
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+static void
+put_pixel(const void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    op_fill(GET_MIPI_DISPLAY_CONFIG(self), x0, y0, 1, 1, color);
+}
+
+static void
+blit(const void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    op_bitmap(GET_MIPI_DISPLAY_CONFIG(self), HAGL_HAL_OP_BLIT, x0, y0, src->width, src->height, src);
+}
+
+static void
+scale_blit(const void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    op_bitmap(GET_MIPI_DISPLAY_CONFIG(self), HAGL_HAL_OP_SCALE_BLIT, x0, y0, w, h, src);
+}
+
+static void
+hline(const void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    op_fill(GET_MIPI_DISPLAY_CONFIG(self), x0, y0, width, 1, color);
+}
+
+static void
+vline(const void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    op_fill(GET_MIPI_DISPLAY_CONFIG(self), x0, y0, 1, height, color);
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    mipi_display_config_t *display_config = (mipi_display_config_t *)backend->display_config;
+    mipi_display_init(display_config);
+
+    display_config->prev_clip.x0 = 0;
+    display_config->prev_clip.x1 = 0;
+    display_config->prev_clip.y0 = 0;
+    display_config->prev_clip.y1 = 0;
+
+    size_t size = display_config->width * HAGL_HAL_BAND_HEIGHT * (display_config->depth / 8);
+
+    if (!backend->buffer) {
+        backend->buffer = hagl_hal_buffer_calloc(display_config, 0, size * 2, backend->haglCalloc);
+        hagl_hal_debug("Allocated band buffers to address %p.\n", (void *) backend->buffer);
+    } else {
+        hagl_hal_debug("Using provided band buffers at address %p.\n", (void *) backend->buffer);
+    }
+
+    hagl_bitmap_init(&display_config->band[0], display_config->width, HAGL_HAL_BAND_HEIGHT, display_config->depth, backend->buffer);
+    hagl_bitmap_init(&display_config->band[1], display_config->width, HAGL_HAL_BAND_HEIGHT, display_config->depth, backend->buffer + size);
+
+    display_config->op_count = 0;
+    display_config->op_pixel_count = 0;
+
+    backend->width = display_config->width;
+    backend->height = display_config->height;
+    backend->depth = display_config->depth;
+    backend->put_pixel = put_pixel;
+    backend->hline = hline;
+    backend->vline = vline;
+    backend->blit = blit;
+    backend->scale_blit = scale_blit;
+    backend->flush = flush;
+}
+
+#endif /* HAGL_HAL_USE_BAND_BUFFER */
@@ -43,11 +43,13 @@ assumed to be valid.
 
 #include "hagl_hal.h"
 
-#ifdef HAGL_HAL_USE_DOUBLE_BUFFER
+#if defined(HAGL_HAL_USE_DOUBLE_BUFFER) || defined(HAGL_HAL_USE_RUNTIME_BUFFER)
 
 #include <string.h>
 #include <hardware/gpio.h>
+#include <pico/time.h>
 #include <mipi_display.h>
+#include <hagl_hal_indexed.h>
 #include <mipi_dcs.h>
 
 #include <hagl/backend.h>
@@ -57,43 +59,477 @@ assumed to be valid.
 #include <stdio.h>
 #include <stdlib.h>
 
+/*
+ * Send an area of the back buffer. Indexed colors are expanded and pixels
+ * upscaled if pixel size is over one.
+ */
+static inline size_t
+write_rect(mipi_display_config_t *display_config, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch)
+{
+#if defined(HAGL_HAL_USE_INDEXED_COLOR)
+    return hagl_hal_indexed_write(display_config, x0, y0, w, h, buffer, pitch);
+#elif HAGL_HAL_PIXEL_SIZE > 1
+    buffer += y0 * pitch + x0 * sizeof(hagl_color_t);
+    return mipi_display_write_xywh_scaled(display_config, x0, y0, w, h, buffer, pitch, HAGL_HAL_PIXEL_SIZE);
+#else
+    buffer += y0 * pitch + x0 * sizeof(hagl_color_t);
+    return mipi_display_write_xywh_pitch(display_config, x0, y0, w, h, buffer, pitch);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+}
+
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+static inline uint32_t
+dirty_area(const hagl_window_t *rect)
+{
+    return (uint32_t) (rect->x1 - rect->x0 + 1) * (rect->y1 - rect->y0 + 1);
+}
+
+static inline void
+dirty_union(hagl_window_t *rect, const hagl_window_t *other)
+{
+    if (other->x0 < rect->x0) {
+        rect->x0 = other->x0;
+    }
+    if (other->y0 < rect->y0) {
+        rect->y0 = other->y0;
+    }
+    if (other->x1 > rect->x1) {
+        rect->x1 = other->x1;
+    }
+    if (other->y1 > rect->y1) {
+        rect->y1 = other->y1;
+    }
+}
+
+/*
+ * Record a damaged area of the back buffer. Overlapping and touching
+ * rectangles are merged. When the set is full the new rectangle is merged
+ * with the one which grows the least.
+ */
+static void
+dirty_add(mipi_display_config_t *display_config, int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+    hagl_window_t rect;
+    hagl_window_t *dirty = display_config->dirty;
+
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 >= display_config->bb->width) {
+        x1 = display_config->bb->width - 1;
+    }
+    if (y1 >= display_config->bb->height) {
+        y1 = display_config->bb->height - 1;
+    }
+    if (x1 < x0 || y1 < y0) {
+        return;
+    }
+
+    rect.x0 = x0;
+    rect.y0 = y0;
+    rect.x1 = x1;
+    rect.y1 = y1;
+
+    /* Consecutive primitives usually hit the most recent rectangle. */
+    if (display_config->dirty_count) {
+        hagl_window_t *last = &dirty[display_config->dirty_count - 1];
+        if (rect.x0 >= last->x0 && rect.x1 <= last->x1 && rect.y0 >= last->y0 && rect.y1 <= last->y1) {
+            return;
+        }
+    }
+
+merge:
+    for (uint8_t i = 0; i < display_config->dirty_count; i++) {
+        if (rect.x0 <= dirty[i].x1 + 1 && dirty[i].x0 <= rect.x1 + 1 &&
+                rect.y0 <= dirty[i].y1 + 1 && dirty[i].y0 <= rect.y1 + 1) {
+            dirty_union(&rect, &dirty[i]);
+            dirty[i] = dirty[--display_config->dirty_count];
+            goto merge;
+        }
+    }
+
+    if (display_config->dirty_count < HAGL_HAL_DIRTY_RECTS) {
+        dirty[display_config->dirty_count++] = rect;
+        return;
+    }
+
+    uint8_t best = 0;
+    uint32_t best_waste = UINT32_MAX;
+
+    for (uint8_t i = 0; i < display_config->dirty_count; i++) {
+        hagl_window_t merged = rect;
+        dirty_union(&merged, &dirty[i]);
+        uint32_t waste = dirty_area(&merged) - dirty_area(&dirty[i]) - dirty_area(&rect);
+        if (waste < best_waste) {
+            best = i;
+            best_waste = waste;
+        }
+    }
+
+    /* Merged rectangle might now overlap others so start over. */
+    dirty_union(&rect, &dirty[best]);
+    dirty[best] = dirty[--display_config->dirty_count];
+    goto merge;
+}
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+
+/* Record that an area of the back buffer was drawn to. */
+static inline void
+damage(const void *self, int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    dirty_add(GET_MIPI_DISPLAY_CONFIG(self), x0, y0, x1, y1);
+#else
+    (void) self;
+    (void) x0;
+    (void) y0;
+    (void) x1;
+    (void) y1;
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+#ifdef HAGL_HAL_USE_LOW_POWER
+    (GET_MIPI_DISPLAY_CONFIG(self))->drawn = true;
+#endif /* HAGL_HAL_USE_LOW_POWER */
+}
+
+#ifdef HAGL_HAL_USE_BEAM_RACE
+/*
+ * Write rows of the back buffer and measure how long one row takes. The
+ * transfer is waited for so the measurement includes the whole write.
+ */
 static size_t
-flush(const void *self)
+beam_write(mipi_display_config_t *display_config, hagl_bitmap_t *bb, uint16_t y0, uint16_t h)
 {
-    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
-    if (display_config->pin_te > 0) {
-        while (!gpio_get(display_config->pin_te)) {}
+    uint64_t start = time_us_64();
+    size_t sent = write_rect(display_config, 0, y0, bb->width, h, (uint8_t *) bb->buffer, bb->pitch);
+    mipi_display_sync(display_config);
+
+    uint32_t row_time = (time_us_64() - start) / h;
+    if (0 == display_config->beam_row_time) {
+        display_config->beam_row_time = row_time;
+    } else {
+        display_config->beam_row_time = (display_config->beam_row_time * 3 + row_time) / 4;
+    }
+    return sent;
+}
+
+/*
+ * Send the whole back buffer chasing the scanout. Scan position is not
+ * read from the panel but estimated from the time since TE and the
+ * measured refresh period. With the scan time of a frame S and write time
+ * of a frame W, starting at phase p since TE is tear free when:
+ *
+ *   W <= S:      p >= S - W, the write finishes behind the scan
+ *   W <= 2 * S:  p <= 2 * S - W, next scan does not overtake the write
+ *
+ * Writes slower than that are split into chunks which are each started
+ * right behind the scan and finish before the next scan reaches them.
+ * Chunk positions are measured from the TE which started the first one.
+ */
+static size_t
+beam_race(mipi_display_config_t *display_config, hagl_bitmap_t *bb)
+{
+    uint32_t period = display_config->vblank_period;
+    uint32_t row_time = display_config->beam_row_time;
+    uint16_t height = bb->height;
+
+    /* Not calibrated yet, start at TE and measure. */
+    if (0 == period || 0 == row_time) {
+        mipi_display_vblank_wait(display_config);
+        return beam_write(display_config, bb, 0, height);
+    }
+
+    uint32_t write = row_time * height;
+    uint32_t margin = period * HAGL_HAL_BEAM_MARGIN / height;
+    uint32_t phase = mipi_display_vblank_phase(display_config);
+
+    if (write + margin <= period) {
+        if (phase < period - write) {
+            mipi_display_vblank_wait_phase(display_config, period - write);
+        }
+        return beam_write(display_config, bb, 0, height);
+    }
+
+    if (write + margin <= 2 * period) {
+        if (phase + write + margin > 2 * period) {
+            mipi_display_vblank_wait(display_config);
+        }
+        return beam_write(display_config, bb, 0, height);
+    }
+
+    /* Too slow to keep ahead, write chunks right behind the scan. */
+    size_t sent = 0;
+    uint16_t chunk = (uint64_t) height * (period - margin) / write;
+    if (0 == chunk) {
+        chunk = 1;
+    }
+    uint64_t frame = 0;
+    for (uint16_t y = 0; y < height; y += chunk) {
+        uint16_t h = (height - y < chunk) ? height - y : chunk;
+        uint32_t target = (uint64_t) period * y / height + margin;
+        if (0 == y) {
+            mipi_display_vblank_wait_phase(display_config, target);
+            frame = time_us_64() - target;
+        } else {
+            /* Wait only if ahead of the scan, otherwise keep writing. */
+            uint64_t phase = time_us_64() - frame;
+            if (phase < target) {
+                sleep_us(target - phase);
+            }
+        }
+        sent += beam_write(display_config, bb, y, h);
     }
+    hagl_hal_debug("Beam race split frame to %d chunks.\n", (height + chunk - 1) / chunk);
+    return sent;
+}
+#endif /* HAGL_HAL_USE_BEAM_RACE */
 
+static size_t
+send_back_buffer(const void *self)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
     hagl_bitmap_t *bb = GET_BB(self);
-#if HAGL_HAL_PIXEL_SIZE==1
+
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    mipi_display_vblank_wait(display_config);
+
+    /* Flush only the damaged areas of the back buffer. */
+    size_t sent = 0;
+#ifdef HAGL_HAL_USE_MULTICORE
+    for (uint8_t i = 0; i < display_config->dirty_flush_count; i++) {
+        hagl_window_t *rect = &display_config->dirty_flush[i];
+#else
+    for (uint8_t i = 0; i < display_config->dirty_count; i++) {
+        hagl_window_t *rect = &display_config->dirty[i];
+#endif /* HAGL_HAL_USE_MULTICORE */
+        sent += write_rect(
+                    display_config,
+                    rect->x0, rect->y0,
+                    rect->x1 - rect->x0 + 1, rect->y1 - rect->y0 + 1,
+                    bb->buffer, bb->pitch
+                );
+    }
+#ifndef HAGL_HAL_USE_MULTICORE
+    display_config->dirty_count = 0;
+#endif /* HAGL_HAL_USE_MULTICORE */
+    return sent;
+#elif defined(HAGL_HAL_USE_BEAM_RACE)
+    /* Flush the whole back buffer racing the scanout. */
+    return beam_race(display_config, bb);
+#else
+    mipi_display_vblank_wait(display_config);
+
     /* Flush the whole back buffer. */
-    return mipi_display_write_xywh(display_config, 0, 0, bb->width, bb->height, (uint8_t *) bb->buffer);
-#endif /* HAGL_HAL_PIXEL_SIZE==1 */
+    return write_rect(display_config, 0, 0, bb->width, bb->height, (uint8_t *) bb->buffer, bb->pitch);
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+}
 
-#if HAGL_HAL_PIXEL_SIZE==2
-    static hagl_color_t line[MIPI_DISPLAY_WIDTH];
+static size_t
+flush_back_buffer(const void *self)
+{
+#ifdef HAGL_HAL_USE_COUNTERS
+    uint64_t start = time_us_64();
+    size_t sent = send_back_buffer(self);
+    mipi_display_count_flush(GET_MIPI_DISPLAY_CONFIG(self), start);
+    return sent;
+#else
+    return send_back_buffer(self);
+#endif /* HAGL_HAL_USE_COUNTERS */
+}
+
+static size_t
+flush(const void *self)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
 
-    hagl_color_t *ptr = (hagl_color_t *) bb.buffer;
     size_t sent = 0;
 
-    for (uint16_t y = 0; y < HAGL_PICO_MIPI_DISPLAY_HEIGHT; y++) {
-        for (uint16_t x = 0; x < HAGL_PICO_MIPI_DISPLAY_WIDTH; x++) {
-            line[x * 2] = *(ptr);
-            line[x * 2 + 1] = *(ptr++);
-        }
-        sent += mipi_display_write_xywh(display_config, 0, y * 2, MIPI_DISPLAY_WIDTH, 1, (uint8_t *) line);
-        sent += mipi_display_write_xywh(display_config, 0, y * 2 + 1, MIPI_DISPLAY_WIDTH, 1, (uint8_t *) line);
+#ifdef HAGL_HAL_USE_MULTICORE
+    /* Bytes sent by the previous flush which was running on core 1. */
+    sent = mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    /* Nothing was drawn since last flush. */
+    if (0 == display_config->dirty_count) {
+        return sent;
+    }
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    /* Display stays in low power mode until something is drawn. */
+    if (!display_config->drawn) {
+        return sent;
     }
+    display_config->drawn = false;
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_MULTICORE
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    /* Drawing continues while core 1 flushes so take a copy. */
+    memcpy(display_config->dirty_flush, display_config->dirty, sizeof(display_config->dirty));
+    display_config->dirty_flush_count = display_config->dirty_count;
+    display_config->dirty_count = 0;
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+    mipi_display_submit(display_config, flush_back_buffer, self);
     return sent;
-#endif /* HAGL_HAL_PIXEL_SIZE==2 */
+#else
+    (void) display_config;
+    return sent + flush_back_buffer(self);
+#endif /* HAGL_HAL_USE_MULTICORE */
+}
+
+size_t
+hagl_hal_flush_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+    hagl_bitmap_t *bb = GET_BB(backend);
+
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+    int16_t x1 = x0 + w - 1;
+    int16_t y1 = y0 + h - 1;
+
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 >= bb->width) {
+        x1 = bb->width - 1;
+    }
+    if (y1 >= bb->height) {
+        y1 = bb->height - 1;
+    }
+    if (x1 < x0 || y1 < y0) {
+        return 0;
+    }
+
+    return write_rect(
+               display_config,
+               x0, y0,
+               x1 - x0 + 1, y1 - y0 + 1,
+               bb->buffer, bb->pitch
+           );
+}
+
+#ifdef HAGL_HAL_USE_FENCE
+mipi_display_fence_t
+hagl_hal_flush_async(hagl_backend_t *backend)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+
+    flush(backend);
+    return mipi_display_fence(display_config);
+}
+#endif /* HAGL_HAL_USE_FENCE */
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+void
+hagl_hal_set_palette(hagl_backend_t *backend, const hagl_color_t *palette, uint16_t count)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+    hagl_hal_indexed_palette(display_config, palette, count);
+
+    /* Every pixel might have changed. */
+    damage(backend, 0, 0, backend->width - 1, backend->height - 1);
 }
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
+#ifdef HAGL_HAL_USE_SCROLL
+/* Make sure GRAM matches the back buffer before moving things around. */
+static void
+scroll_sync(const void *self)
+{
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    flush(self);
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(GET_MIPI_DISPLAY_CONFIG(self));
+#endif /* HAGL_HAL_USE_MULTICORE */
+#if !defined(HAGL_HAL_USE_DIRTY_RECTS) && !defined(HAGL_HAL_USE_MULTICORE)
+    (void) self;
+#endif
+}
+
+void
+hagl_hal_scroll_area(hagl_backend_t *backend, uint16_t top, uint16_t bottom)
+{
+    scroll_sync(backend);
+    mipi_display_scroll_area(GET_MIPI_DISPLAY_CONFIG(backend), top, bottom);
+}
+
+/*
+ * Rows of the scrolling area are moved in the back buffer too so that it
+ * keeps matching what is on the display. Only the exposed rows are marked
+ * dirty, the rest are already in GRAM.
+ */
+void
+hagl_hal_scroll(hagl_backend_t *backend, int16_t lines)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+    hagl_bitmap_t *bb = GET_BB(backend);
+    int16_t top = display_config->scroll_top;
+    int16_t bottom = display_config->height - display_config->scroll_bottom;
+    int16_t count = abs(lines);
+
+    if (0 == lines || bottom <= top) {
+        return;
+    }
+    if (count > bottom - top) {
+        count = bottom - top;
+    }
+
+    scroll_sync(backend);
+
+    uint8_t *area = bb->buffer + top * bb->pitch;
+    size_t length = (bottom - top - count) * bb->pitch;
+    if (lines > 0) {
+        memmove(area, area + count * bb->pitch, length);
+    } else {
+        memmove(area + count * bb->pitch, area, length);
+    }
+
+    mipi_display_scroll(display_config, lines);
+
+    if (lines > 0) {
+        damage(backend, 0, bottom - count, bb->width - 1, bottom - 1);
+    } else {
+        damage(backend, 0, top, bb->width - 1, top + count - 1);
+    }
+}
+#endif /* HAGL_HAL_USE_SCROLL */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+void
+hagl_hal_power_mode(hagl_backend_t *backend, uint8_t mode, const hagl_window_t *area)
+{
+    mipi_display_power_mode(GET_MIPI_DISPLAY_CONFIG(backend), mode, area);
+}
+
+void
+hagl_hal_power_time(hagl_backend_t *backend, uint64_t *time)
+{
+    mipi_display_power_time(GET_MIPI_DISPLAY_CONFIG(backend), time);
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
 
 static void
 put_pixel(const void *self, int16_t x0, int16_t y0, hagl_color_t color)
 {
     hagl_bitmap_t *bb = GET_BB(self);
     bb->put_pixel(bb, x0, y0, color);
+    damage(self, x0, y0, x0, y0);
 }
 
 static hagl_color_t
@@ -108,6 +544,7 @@ blit(const void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
     hagl_bitmap_t *bb = GET_BB(self);
     bb->blit(bb, x0, y0, src);
+    damage(self, x0, y0, x0 + src->width - 1, y0 + src->height - 1);
 }
 
 static void
@@ -115,6 +552,7 @@ scale_blit(const void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, h
 {
     hagl_bitmap_t *bb = GET_BB(self);
     bb->scale_blit(bb, x0, y0, w, h, src);
+    damage(self, x0, y0, x0 + w - 1, y0 + h - 1);
 }
 
 static void
@@ -122,6 +560,7 @@ hline(const void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t col
 {
     hagl_bitmap_t *bb = GET_BB(self);
     bb->hline(bb, x0, y0, width, color);
+    damage(self, x0, y0, x0 + width - 1, y0);
 }
 
 static void
@@ -129,31 +568,47 @@ vline(const void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t co
 {
     hagl_bitmap_t *bb = GET_BB(self);
     bb->vline(bb, x0, y0, height, color);
+    damage(self, x0, y0, x0, y0 + height - 1);
 }
 
 void
-hagl_hal_init(hagl_backend_t *backend)
+hagl_hal_double_init(hagl_backend_t *backend)
 {
     mipi_display_config_t *display_config = (mipi_display_config_t *)backend->display_config;
-    mipi_display_init(display_config);
 
     /* Initialize dynamic display information */
-    display_config->bb = backend->haglCalloc(sizeof(hagl_bitmap_t), sizeof(uint8_t));
+    /* Runtime buffering frees this with free() when switching. */
+    display_config->bb = calloc(1, sizeof(hagl_bitmap_t));
     display_config->prev_clip.x0 = 0;
     display_config->prev_clip.x1 = 0;
     display_config->prev_clip.y0 = 0;
     display_config->prev_clip.y1 = 0;
 
+    /* Back buffer is smaller than the display when pixel size is over one. */
+    backend->width = display_config->width / HAGL_HAL_PIXEL_SIZE;
+    backend->height = display_config->height / HAGL_HAL_PIXEL_SIZE;
+    backend->depth = display_config->depth;
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+    size_t size = hagl_hal_indexed_size(backend->width, backend->height);
+#else
+    size_t size = backend->width * backend->height * (backend->depth / 8);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
     if (!backend->buffer) {
-        backend->buffer = backend->haglCalloc(display_config->width * display_config->height * (display_config->depth / 8), sizeof(uint8_t));
+        backend->buffer = hagl_hal_buffer_calloc(display_config, 0, size, backend->haglCalloc);
         hagl_hal_debug("Allocated back buffer to address %p.\n", (void *) backend->buffer);
     } else {
         hagl_hal_debug("Using provided back buffer at address %p.\n", (void *) backend->buffer);
     }
 
-    backend->width = display_config->width;
-    backend->height = display_config->height;
-    backend->depth = display_config->depth;
+#if defined(HAGL_HAL_USE_INDEXED_COLOR) || HAGL_HAL_PIXEL_SIZE > 1
+    /* Two display wide lines, one is expanded while the other is sent. */
+    display_config->line_buffer[0] = hagl_hal_buffer_calloc(display_config, 0, display_config->width * 2 * sizeof(hagl_color_t), backend->haglCalloc);
+    display_config->line_buffer[1] = display_config->line_buffer[0] + display_config->width;
+    hagl_hal_debug("Allocated line buffers to address %p.\n", (void *) display_config->line_buffer[0]);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR || HAGL_HAL_PIXEL_SIZE > 1 */
+
     backend->put_pixel = put_pixel;
     backend->get_pixel = get_pixel;
     backend->hline = hline;
@@ -162,8 +617,32 @@ hagl_hal_init(hagl_backend_t *backend)
     backend->scale_blit = scale_blit;
     backend->flush = flush;
 
-    hagl_bitmap_init(display_config->bb, display_config->width, display_config->height, display_config->depth, backend->buffer);
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+    hagl_hal_indexed_init(display_config->bb, backend->width, backend->height, backend->buffer);
+#else
+    hagl_bitmap_init(display_config->bb, backend->width, backend->height, backend->depth, backend->buffer);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
     hagl_hal_debug("Bitmap initialized: %p.\n", (void *) display_config->bb);
+
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    display_config->dirty_count = 0;
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+
+#ifdef HAGL_HAL_USE_BEAM_RACE
+    display_config->beam_row_time = 0;
+#endif /* HAGL_HAL_USE_BEAM_RACE */
+
+    /* GRAM content is unknown so the first flush sends everything. */
+    damage(backend, 0, 0, backend->width - 1, backend->height - 1);
+}
+
+#ifndef HAGL_HAL_USE_RUNTIME_BUFFER
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    mipi_display_init((mipi_display_config_t *)backend->display_config);
+    hagl_hal_double_init(backend);
 }
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
 
-#endif /* HAGL_HAL_USE_DOUBLE_BUFFER */
+#endif /* HAGL_HAL_USE_DOUBLE_BUFFER || HAGL_HAL_USE_RUNTIME_BUFFER */
@@ -0,0 +1,270 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Indexed color back buffer. Pixels are 4 or 8 bit indices to a palette of
+16 or 256 colors. Indices are expanded to colors when flushing, a line at
+a time, into two line buffers which are sent in turns. With DMA the next
+line is expanded while the previous one is being sent.
+
+With 4 bit indices the expansion uses a lookup table which gives two
+pixels for each byte of the back buffer.
+
+*/
+
+#include "hagl_hal.h"
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+
+#include <string.h>
+
+#include <hagl/bitmap.h>
+
+#include "hagl_hal_indexed.h"
+#include "mipi_display.h"
+
+#if HAGL_HAL_INDEXED_DEPTH != 4 && HAGL_HAL_INDEXED_DEPTH != 8
+#error "HAGL_HAL_INDEXED_DEPTH must be 4 or 8"
+#endif
+
+#if HAGL_HAL_PIXEL_SIZE > 1
+#error "HAGL_HAL_USE_INDEXED_COLOR cannot be used with HAGL_HAL_PIXEL_SIZE"
+#endif
+
+static inline void
+indexed_set(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0, hagl_color_t color)
+{
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    uint8_t *ptr = bitmap->buffer + bitmap->pitch * y0 + (x0 >> 1);
+
+    /* First pixel is in the high nibble. */
+    if (x0 & 1) {
+        *ptr = (*ptr & 0xf0) | (color & 0x0f);
+    } else {
+        *ptr = (*ptr & 0x0f) | (color << 4);
+    }
+#else
+    bitmap->buffer[bitmap->pitch * y0 + x0] = color;
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+}
+
+static inline hagl_color_t
+indexed_get(hagl_bitmap_t *bitmap, int16_t x0, int16_t y0)
+{
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    uint8_t value = bitmap->buffer[bitmap->pitch * y0 + (x0 >> 1)];
+    return (x0 & 1) ? (value & 0x0f) : (value >> 4);
+#else
+    return bitmap->buffer[bitmap->pitch * y0 + x0];
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+}
+
+static void
+put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    indexed_set(self, x0, y0, color);
+}
+
+static hagl_color_t
+get_pixel(void *self, int16_t x0, int16_t y0)
+{
+    return indexed_get(self, x0, y0);
+}
+
+static void
+hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    hagl_bitmap_t *bitmap = self;
+
+    if (0 == width) {
+        return;
+    }
+
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    /* Partial bytes at both ends, whole bytes in between. */
+    if (x0 & 1) {
+        indexed_set(bitmap, x0++, y0, color);
+        width--;
+    }
+    if (width & 1) {
+        indexed_set(bitmap, x0 + width - 1, y0, color);
+    }
+    memset(bitmap->buffer + bitmap->pitch * y0 + (x0 >> 1), (color & 0x0f) * 0x11, width >> 1);
+#else
+    memset(bitmap->buffer + bitmap->pitch * y0 + x0, color, width);
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+}
+
+static void
+vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    for (uint16_t y = 0; y < height; y++) {
+        indexed_set(self, x0, y0 + y, color);
+    }
+}
+
+/* Source bitmap holds indices in hagl_color_t sized pixels. */
+static void
+blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    for (int16_t y = 0; y < src->height; y++) {
+        hagl_color_t *ptr = (hagl_color_t *) (src->buffer + src->pitch * y);
+        for (int16_t x = 0; x < src->width; x++) {
+            indexed_set(self, x0 + x, y0 + y, ptr[x]);
+        }
+    }
+}
+
+static void
+scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    hagl_bitmap_t *bitmap = self;
+    uint32_t x_ratio = (uint32_t)((src->width << 16) / w) + 1;
+    uint32_t y_ratio = (uint32_t)((src->height << 16) / h) + 1;
+
+    for (uint16_t y = 0; y < h && y0 + y < bitmap->height; y++) {
+        hagl_color_t *ptr = (hagl_color_t *) (src->buffer + src->pitch * ((y * y_ratio) >> 16));
+        for (uint16_t x = 0; x < w && x0 + x < bitmap->width; x++) {
+            indexed_set(bitmap, x0 + x, y0 + y, ptr[(x * x_ratio) >> 16]);
+        }
+    }
+}
+
+/* Rows are padded to whole words. */
+static inline size_t
+indexed_pitch(int16_t width)
+{
+    return ((width * HAGL_HAL_INDEXED_DEPTH + 31) / 32) * 4;
+}
+
+size_t
+hagl_hal_indexed_size(int16_t width, int16_t height)
+{
+    return indexed_pitch(width) * height;
+}
+
+void
+hagl_hal_indexed_init(hagl_bitmap_t *bitmap, int16_t width, int16_t height, uint8_t *buffer)
+{
+    bitmap->width = width;
+    bitmap->height = height;
+    bitmap->depth = HAGL_HAL_INDEXED_DEPTH;
+    bitmap->pitch = indexed_pitch(width);
+    bitmap->size = bitmap->pitch * height;
+    bitmap->buffer = buffer;
+
+    bitmap->put_pixel = put_pixel;
+    bitmap->get_pixel = get_pixel;
+    bitmap->hline = hline;
+    bitmap->vline = vline;
+    bitmap->blit = blit;
+    bitmap->scale_blit = scale_blit;
+}
+
+void
+hagl_hal_indexed_palette(mipi_display_config_t *display_config, const hagl_color_t *palette, uint16_t count)
+{
+    if (count > (1 << HAGL_HAL_INDEXED_DEPTH)) {
+        count = 1 << HAGL_HAL_INDEXED_DEPTH;
+    }
+
+    memcpy(display_config->palette, palette, count * sizeof(hagl_color_t));
+
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    /* Both pixels of a byte with one lookup, first one in the low half. */
+    for (uint16_t i = 0; i < 256; i++) {
+        display_config->palette_pair[i] =
+            display_config->palette[i >> 4] | (uint32_t) display_config->palette[i & 0x0f] << 16;
+    }
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+}
+
+static inline void
+indexed_expand_line(mipi_display_config_t *display_config, hagl_color_t *line, const uint8_t *row, uint16_t x0, uint16_t w)
+{
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    const uint32_t *pair = display_config->palette_pair;
+    const uint8_t *ptr = row + (x0 >> 1);
+
+    if (x0 & 1) {
+        *(line++) = display_config->palette[*(ptr++) & 0x0f];
+        w--;
+    }
+    for (uint16_t x = w >> 1; x > 0; x--) {
+        uint32_t pixels = pair[*(ptr++)];
+        *(line++) = pixels;
+        *(line++) = pixels >> 16;
+    }
+    if (w & 1) {
+        *line = display_config->palette[*ptr >> 4];
+    }
+#else
+    const hagl_color_t *palette = display_config->palette;
+    const uint8_t *ptr = row + x0;
+
+    for (uint16_t x = 0; x < w; x++) {
+        line[x] = palette[ptr[x]];
+    }
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+}
+
+size_t
+hagl_hal_indexed_write(mipi_display_config_t *display_config, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, const uint8_t *buffer, size_t pitch)
+{
+    if (0 == w || 0 == h) {
+        return 0;
+    }
+
+    size_t length = w * sizeof(hagl_color_t);
+    uint8_t current = 0;
+
+    buffer += y0 * pitch;
+    mipi_display_start_xywh(display_config, x0, y0, w, h);
+
+    for (uint16_t y = 0; y < h; y++) {
+        hagl_color_t *line = display_config->line_buffer[current];
+
+        indexed_expand_line(display_config, line, buffer, x0, w);
+        mipi_display_write_stream(display_config, (uint8_t *) line, length);
+
+        current ^= 1;
+        buffer += pitch;
+    }
+
+    /* Line buffers are reused by the next call. */
+    mipi_display_sync(display_config);
+
+    /* This should also include the bytes for writing the commands. */
+    return length * h;
+}
+
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
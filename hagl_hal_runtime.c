@@ -0,0 +1,191 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Buffering selected per display at runtime. Single, double and triple
+buffered HALs are all compiled in and the backend functions of each
+display point to the ones of its buffering.
+
+*/
+
+#include "hagl_hal.h"
+
+#ifdef HAGL_HAL_USE_RUNTIME_BUFFER
+
+#include <stdlib.h>
+
+#include <hagl/backend.h>
+
+#include "mipi_display.h"
+
+/* Number of back buffers each buffering uses. */
+static uint8_t
+back_buffers(uint8_t buffering)
+{
+    switch (buffering) {
+    case MIPI_DISPLAY_BUFFERING_SINGLE:
+        return 0;
+    case MIPI_DISPLAY_BUFFERING_DOUBLE:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+/* Free what the current buffering allocated and the new one does not need. */
+static void
+release(hagl_backend_t *backend, uint8_t buffering)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+    uint8_t **buffers[2] = {&backend->buffer, &backend->buffer2};
+
+    /* Reverse order of allocation so that arena can release them. */
+    hagl_hal_buffer_free(display_config, display_config->line_buffer[0]);
+    display_config->line_buffer[0] = NULL;
+    display_config->line_buffer[1] = NULL;
+
+    for (int8_t i = 1; i >= back_buffers(buffering); i--) {
+        if (display_config->allocated[i]) {
+            hagl_hal_debug("Freeing back buffer at address %p.\n", (void *) display_config->allocated[i]);
+            hagl_hal_buffer_free(display_config, display_config->allocated[i]);
+            display_config->allocated[i] = NULL;
+            *buffers[i] = NULL;
+        }
+    }
+
+    free(display_config->bb);
+    display_config->bb = NULL;
+
+#ifdef HAGL_HAL_USE_ROW_HASH
+    free(display_config->row_hash);
+    free(display_config->row_changed);
+    display_config->row_hash = NULL;
+    display_config->row_changed = NULL;
+#ifdef HAGL_HAL_USE_DMA
+    /* Triple buffering claims the sniffer channel again when switched to. */
+    if (MIPI_DISPLAY_BUFFERING_TRIPLE == display_config->buffering) {
+        dma_channel_unclaim(display_config->row_hash_dma_channel);
+    }
+#endif /* HAGL_HAL_USE_DMA */
+#endif /* HAGL_HAL_USE_ROW_HASH */
+}
+
+static void
+setup(hagl_backend_t *backend, uint8_t buffering)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+    uint8_t *buffer = backend->buffer;
+    uint8_t *buffer2 = backend->buffer2;
+
+    display_config->buffering = buffering;
+
+    /* Single buffering does not provide these. */
+    backend->get_pixel = NULL;
+    backend->flush = NULL;
+
+    switch (buffering) {
+    case MIPI_DISPLAY_BUFFERING_SINGLE:
+        hagl_hal_single_init(backend);
+        break;
+    case MIPI_DISPLAY_BUFFERING_DOUBLE:
+        hagl_hal_double_init(backend);
+        break;
+    default:
+        hagl_hal_triple_init(backend);
+        break;
+    }
+
+    /* Back buffers which were not there before were allocated by the HAL. */
+    if (backend->buffer != buffer) {
+        display_config->allocated[0] = backend->buffer;
+    }
+    if (backend->buffer2 != buffer2) {
+        display_config->allocated[1] = backend->buffer2;
+    }
+}
+
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    mipi_display_config_t *display_config = (mipi_display_config_t *)backend->display_config;
+    uint8_t buffering = display_config->buffering;
+
+    if (MIPI_DISPLAY_BUFFERING_DEFAULT == buffering) {
+        buffering = HAGL_HAL_BUFFERING;
+    }
+
+    hagl_hal_debug("Initialising display with buffering %d.\n", buffering);
+    mipi_display_init(display_config);
+
+    display_config->allocated[0] = NULL;
+    display_config->allocated[1] = NULL;
+    display_config->bb = NULL;
+    display_config->line_buffer[0] = NULL;
+    display_config->line_buffer[1] = NULL;
+
+    setup(backend, buffering);
+}
+
+void
+hagl_hal_set_buffering(hagl_backend_t *backend, uint8_t buffering)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+
+    if (MIPI_DISPLAY_BUFFERING_DEFAULT == buffering) {
+        buffering = HAGL_HAL_BUFFERING;
+    }
+
+    if (buffering == display_config->buffering) {
+        return;
+    }
+
+    /* Drains the display list when single buffering. */
+    if (MIPI_DISPLAY_BUFFERING_SINGLE == display_config->buffering && backend->flush) {
+        backend->flush(backend);
+    }
+
+    /* Nothing may read the buffers which are about to be freed. */
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    mipi_display_bus_sync(display_config);
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+    /* Also waits for the transfer itself. */
+    mipi_display_vblank_sync(display_config);
+
+    hagl_hal_debug("Switching display from buffering %d to %d.\n", display_config->buffering, buffering);
+    release(backend, buffering);
+    setup(backend, buffering);
+}
+
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
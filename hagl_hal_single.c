@@ -42,50 +42,312 @@ valid.
 
 #include "hagl_hal.h"
 
-#ifdef HAGL_HAL_USE_SINGLE_BUFFER
+#if defined(HAGL_HAL_USE_SINGLE_BUFFER) || defined(HAGL_HAL_USE_RUNTIME_BUFFER)
 
 #include <hagl/bitmap.h>
 #include <hagl/backend.h>
 #include <hagl.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "mipi_display.h"
 
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+/* Send all queued commands in one pass. */
+static size_t
+list_drain(mipi_display_config_t *display_config)
+{
+    size_t sent = 0;
+
+    for (uint16_t i = 0; i < display_config->list_count; i++) {
+        hagl_hal_command_t *command = &display_config->list[i];
+        if (command->solid) {
+            sent += mipi_display_fill_xywh(
+                        display_config, command->x0, command->y0, command->w, command->h, &command->color
+                    );
+        } else {
+            sent += mipi_display_write_xywh(
+                        display_config, command->x0, command->y0, command->w, command->h,
+                        (uint8_t *) &display_config->list_pixels[command->offset]
+                    );
+        }
+    }
+
+    display_config->list_count = 0;
+    display_config->list_pixel_count = 0;
+
+    return sent;
+}
+
+static void
+list_add(mipi_display_config_t *display_config, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (HAGL_HAL_DISPLAY_LIST_SIZE == display_config->list_count) {
+        list_drain(display_config);
+    }
+
+    hagl_hal_command_t *command = &display_config->list[display_config->list_count++];
+    command->x0 = x0;
+    command->y0 = y0;
+    command->w = w;
+    command->h = h;
+    command->color = color;
+    command->solid = true;
+}
+
+/*
+ * Pixels continuing a horizontal or vertical run are appended to the
+ * previous command. Runs with several colors keep their pixels in the
+ * pixel pool and share one address window.
+ */
+static void
+list_pixel(mipi_display_config_t *display_config, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    if (display_config->list_count) {
+        hagl_hal_command_t *last = &display_config->list[display_config->list_count - 1];
+        bool horizontal = (1 == last->h && y0 == last->y0 && x0 == last->x0 + last->w);
+        bool vertical = (1 == last->w && x0 == last->x0 && y0 == last->y0 + last->h);
+
+        if (horizontal || vertical) {
+            uint16_t size = last->w * last->h;
+
+            if (last->solid && color == last->color) {
+                last->w += horizontal;
+                last->h += vertical;
+                return;
+            }
+
+            if (last->solid && display_config->list_pixel_count + size < HAGL_HAL_DISPLAY_LIST_PIXELS) {
+                last->offset = display_config->list_pixel_count;
+                last->solid = false;
+                for (uint16_t i = 0; i < size; i++) {
+                    display_config->list_pixels[display_config->list_pixel_count++] = last->color;
+                }
+            }
+
+            /* Pixels of the last command are always at the end of the pool. */
+            if (!last->solid && display_config->list_pixel_count < HAGL_HAL_DISPLAY_LIST_PIXELS) {
+                display_config->list_pixels[display_config->list_pixel_count++] = color;
+                last->w += horizontal;
+                last->h += vertical;
+                return;
+            }
+        }
+    }
+
+    list_add(display_config, x0, y0, 1, 1, color);
+}
+
+/* Consecutive lines of same color and length are merged into rectangles. */
+static void
+list_line(mipi_display_config_t *display_config, int16_t x0, int16_t y0, uint16_t w, uint16_t h, hagl_color_t color)
+{
+    if (display_config->list_count) {
+        hagl_hal_command_t *last = &display_config->list[display_config->list_count - 1];
+
+        if (last->solid && color == last->color) {
+            if (x0 == last->x0 && w == last->w && y0 == last->y0 + last->h) {
+                last->h += h;
+                return;
+            }
+            if (y0 == last->y0 && h == last->h && x0 == last->x0 + last->w) {
+                last->w += w;
+                return;
+            }
+        }
+    }
+
+    list_add(display_config, x0, y0, w, h, color);
+}
+
+static size_t
+flush(const void *self)
+{
+    return list_drain(GET_MIPI_DISPLAY_CONFIG(self));
+}
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+void
+hagl_hal_power_mode(hagl_backend_t *backend, uint8_t mode, const hagl_window_t *area)
+{
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    /* Queued commands would wake the display up again. */
+    list_drain(GET_MIPI_DISPLAY_CONFIG(backend));
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+    mipi_display_power_mode(GET_MIPI_DISPLAY_CONFIG(backend), mode, area);
+}
+
+void
+hagl_hal_power_time(hagl_backend_t *backend, uint64_t *time)
+{
+    mipi_display_power_time(GET_MIPI_DISPLAY_CONFIG(backend), time);
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
 static void
-put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+put_pixel(const void *self, int16_t x0, int16_t y0, hagl_color_t color)
 {
-    mipi_display_write_xy(x0, y0, (uint8_t *) &color);
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_pixel(display_config, x0, y0, color);
+#else
+    mipi_display_write_xy(display_config, x0, y0, (uint8_t *) &color);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
 }
 
+/* Whole bitmap is sent with one address window. */
 static void
-blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+blit(const void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
-    mipi_display_write_xywh(x0, y0, src->width, src->height, (uint8_t *) src->buffer);
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_drain(display_config);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+    mipi_display_write_xywh(display_config, x0, y0, src->width, src->height, (uint8_t *) src->buffer);
+}
+
+/*
+ * Scaled rows are generated into two line buffers in turns. With DMA the
+ * next row is generated while the previous one is still being sent.
+ * Repeated source rows are sent again without generating them.
+ */
+static void
+scale_blit(const void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+    hagl_color_t *source = (hagl_color_t *) src->buffer;
+    uint32_t x_ratio = (uint32_t)((src->width << 16) / w) + 1;
+    uint32_t y_ratio = (uint32_t)((src->height << 16) / h) + 1;
+    int32_t previous = -1;
+    uint8_t current = 0;
+
+    if (x0 >= display_config->width || y0 >= display_config->height) {
+        return;
+    }
+
+    /* Only the part inside the display is sent. */
+    uint16_t width = w;
+    uint16_t height = h;
+    if (x0 + width > display_config->width) {
+        width = display_config->width - x0;
+    }
+    if (y0 + height > display_config->height) {
+        height = display_config->height - y0;
+    }
+
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_drain(display_config);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+
+    mipi_display_start_xywh(display_config, x0, y0, width, height);
+
+    for (uint16_t y = 0; y < height; y++) {
+        int32_t sy = (y * y_ratio) >> 16;
+
+        if (sy != previous) {
+            hagl_color_t *row = &source[sy * src->width];
+            hagl_color_t *line = display_config->line_buffer[current];
+
+            for (uint16_t x = 0; x < width; x++) {
+                line[x] = row[(x * x_ratio) >> 16];
+            }
+
+            current ^= 1;
+            previous = sy;
+        }
+
+        mipi_display_write_stream(
+            display_config, (uint8_t *) display_config->line_buffer[current ^ 1], width * sizeof(hagl_color_t)
+        );
+    }
+
+    mipi_display_sync(display_config);
 }
 
 static void
-hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+hline(const void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
 {
-    mipi_display_fill_xywh(x0, y0, width, 1, &color);
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_line(display_config, x0, y0, width, 1, color);
+#else
+    mipi_display_fill_xywh(display_config, x0, y0, width, 1, &color);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
 }
 
 static void
-vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+vline(const void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
 {
-    mipi_display_fill_xywh(x0, y0, 1, height, &color);
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_line(display_config, x0, y0, 1, height, color);
+#else
+    mipi_display_fill_xywh(display_config, x0, y0, 1, height, &color);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
 }
 
+#ifdef HAGL_HAL_USE_SCROLL
 void
-hagl_hal_init(hagl_backend_t *backend)
+hagl_hal_scroll_area(hagl_backend_t *backend, uint16_t top, uint16_t bottom)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    /* Queued commands use coordinates from before the change. */
+    list_drain(display_config);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+    mipi_display_scroll_area(display_config, top, bottom);
+}
+
+void
+hagl_hal_scroll(hagl_backend_t *backend, int16_t lines)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    list_drain(display_config);
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+    mipi_display_scroll(display_config, lines);
+}
+#endif /* HAGL_HAL_USE_SCROLL */
+
+void
+hagl_hal_single_init(hagl_backend_t *backend)
 {
-    mipi_display_init();
+    mipi_display_config_t *display_config = (mipi_display_config_t *)backend->display_config;
 
-    backend->width = MIPI_DISPLAY_WIDTH;
-    backend->height = MIPI_DISPLAY_HEIGHT;
-    backend->depth = MIPI_DISPLAY_DEPTH;
+    display_config->prev_clip.x0 = 0;
+    display_config->prev_clip.x1 = 0;
+    display_config->prev_clip.y0 = 0;
+    display_config->prev_clip.y1 = 0;
+
+    /* Two lines for scale_blit(), one is filled while the other is sent. */
+    display_config->line_buffer[0] = hagl_hal_buffer_calloc(display_config, 0, display_config->width * 2 * sizeof(hagl_color_t), backend->haglCalloc);
+    display_config->line_buffer[1] = display_config->line_buffer[0] + display_config->width;
+    hagl_hal_debug("Allocated line buffers to address %p.\n", (void *) display_config->line_buffer[0]);
+
+    backend->width = display_config->width;
+    backend->height = display_config->height;
+    backend->depth = display_config->depth;
     backend->put_pixel = put_pixel;
+    backend->blit = blit;
+    backend->scale_blit = scale_blit;
     backend->hline = hline;
     backend->vline = vline;
+
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    display_config->list_count = 0;
+    display_config->list_pixel_count = 0;
+    backend->flush = flush;
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+}
+
+#ifndef HAGL_HAL_USE_RUNTIME_BUFFER
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    mipi_display_init((mipi_display_config_t *)backend->display_config);
+    hagl_hal_single_init(backend);
 }
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
 
-#endif /* HAGL_HAL_USE_SINGLE_BUFFER */
+#endif /* HAGL_HAL_USE_SINGLE_BUFFER || HAGL_HAL_USE_RUNTIME_BUFFER */
@@ -44,12 +44,15 @@ valid.
 
 #include "hagl_hal.h"
 
-#ifdef HAGL_HAL_USE_TRIPLE_BUFFER
+#if defined(HAGL_HAL_USE_TRIPLE_BUFFER) || defined(HAGL_HAL_USE_RUNTIME_BUFFER)
 
 #include <string.h>
 #include <hardware/gpio.h>
+#include <hardware/dma.h>
+#include <pico/time.h>
 
 #include <mipi_display.h>
+#include <hagl_hal_indexed.h>
 #include <mipi_dcs.h>
 
 #include <hagl/backend.h>
@@ -59,107 +62,376 @@ valid.
 #include <stdio.h>
 #include <stdlib.h>
 
-static hagl_bitmap_t bb;
+/*
+ * Send an area of the back buffer. Indexed colors are expanded and pixels
+ * upscaled if pixel size is over one.
+ */
+static inline size_t
+write_rect(mipi_display_config_t *display_config, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch)
+{
+#if defined(HAGL_HAL_USE_INDEXED_COLOR)
+    return hagl_hal_indexed_write(display_config, x0, y0, w, h, buffer, pitch);
+#elif HAGL_HAL_PIXEL_SIZE > 1
+    buffer += y0 * pitch + x0 * sizeof(hagl_color_t);
+    return mipi_display_write_xywh_scaled(display_config, x0, y0, w, h, buffer, pitch, HAGL_HAL_PIXEL_SIZE);
+#else
+    buffer += y0 * pitch + x0 * sizeof(hagl_color_t);
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    /* Full width rows are one window which can wait for the bus. */
+    if (pitch == w * sizeof(hagl_color_t)) {
+        return mipi_display_bus_write_xywh(display_config, x0, y0, w, h, buffer);
+    }
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+    return mipi_display_write_xywh_pitch(display_config, x0, y0, w, h, buffer, pitch);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+}
 
-static size_t
-flush(void *self)
+#ifdef HAGL_HAL_USE_ROW_HASH
+#ifdef HAGL_HAL_USE_DMA
+static uint32_t row_hash_sink;
+
+static void
+row_hash_init(mipi_display_config_t *display_config)
 {
-    const hagl_backend_t *backend = self;
+    display_config->row_hash_dma_channel = dma_claim_unused_channel(true);
+}
 
-    uint8_t *buffer = bb.buffer;
+/* Checksum is calculated by the DMA sniffer while copying to a dummy word. */
+static uint32_t
+row_hash(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+    int channel = display_config->row_hash_dma_channel;
+    dma_channel_config channel_config = dma_channel_get_default_config(channel);
 
-    /* Flip the buffers. */
-    if (bb.buffer == backend->buffer) {
-        bb.buffer = backend->buffer2;
+    if (0 == (length & 3)) {
+        channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_32);
+        length >>= 2;
     } else {
-        bb.buffer = backend->buffer;
+        channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_16);
+        length >>= 1;
+    }
+    channel_config_set_read_increment(&channel_config, true);
+    channel_config_set_write_increment(&channel_config, false);
+    channel_config_set_sniff_enable(&channel_config, true);
+
+    /* Mode 0x0 is CRC-32 (IEEE802.3). */
+    dma_sniffer_enable(channel, 0x0, true);
+    dma_sniffer_set_data_accumulator(0xffffffff);
+    dma_channel_configure(channel, &channel_config, &row_hash_sink, buffer, length, true);
+    dma_channel_wait_for_finish_blocking(channel);
+
+    return dma_sniffer_get_data_accumulator();
+}
+#else
+static void
+row_hash_init(mipi_display_config_t *display_config)
+{
+}
+
+/* FNV-1a over 32 bit words, back buffers are always word aligned. */
+static uint32_t
+row_hash(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+    const uint32_t *ptr = (const uint32_t *) buffer;
+    uint32_t hash = 0x811c9dc5;
+
+    for (size_t i = length >> 2; i > 0; i--) {
+        hash = (hash ^ *ptr++) * 0x01000193;
+    }
+
+    /* Width times depth might not be a multiple of four. */
+    if (length & 2) {
+        hash = (hash ^ *(const uint16_t *) ptr) * 0x01000193;
+    }
+
+    return hash;
+}
+#endif /* HAGL_HAL_USE_DMA */
+
+/*
+ * Hash each band of scanlines and compare it to the hash of the band
+ * currently in GRAM. Only changed bands are sent, adjacent ones together
+ * as one page address window.
+ */
+static size_t
+flush_changed_rows(mipi_display_config_t *display_config, uint8_t *buffer)
+{
+    uint16_t band = HAGL_HAL_ROW_HASH_BAND;
+    uint16_t bands = display_config->row_hash_count;
+    hagl_bitmap_t *bb = display_config->bb;
+    size_t band_bytes = bb->pitch * band;
+    bool changed = false;
+
+    for (uint16_t i = 0; i < bands; i++) {
+        uint16_t rows = band;
+        if ((i + 1) * band > bb->height) {
+            rows = bb->height - i * band;
+        }
+
+        uint32_t hash = row_hash(display_config, buffer + i * band_bytes, bb->pitch * rows);
+        display_config->row_changed[i] = !display_config->row_hash_valid || hash != display_config->row_hash[i];
+        display_config->row_hash[i] = hash;
+        changed |= display_config->row_changed[i];
+    }
+    display_config->row_hash_valid = true;
+
+    if (!changed) {
+        return 0;
+    }
+
+    mipi_display_vblank_wait(display_config);
+
+    size_t sent = 0;
+    int32_t start = -1;
+
+    for (uint16_t i = 0; i <= bands; i++) {
+        if (i < bands && display_config->row_changed[i]) {
+            if (start < 0) {
+                start = i;
+            }
+            continue;
+        }
+        if (start >= 0) {
+            uint16_t y0 = start * band;
+            uint16_t y1 = i * band;
+            if (y1 > bb->height) {
+                y1 = bb->height;
+            }
+            sent += write_rect(display_config, 0, y0, bb->width, y1 - y0, buffer, bb->pitch);
+            start = -1;
+        }
     }
 
-#if MIPI_DISPLAY_PIN_TE > 0
-    while (!gpio_get(MIPI_DISPLAY_PIN_TE)) {}
-#endif /* MIPI_DISPLAY_PIN_TE > 0 */
+    return sent;
+}
+#endif /* HAGL_HAL_USE_ROW_HASH */
+
+static size_t
+send_back_buffer(const void *self)
+{
+    const hagl_backend_t *backend = self;
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+    hagl_bitmap_t *bb = display_config->bb;
+
+    /* Buffers were already flipped, send the one not being drawn to. */
+    uint8_t *buffer = (bb->buffer == backend->buffer) ? backend->buffer2 : backend->buffer;
+
+#ifdef HAGL_HAL_USE_ROW_HASH
+    return flush_changed_rows(display_config, buffer);
+#else
+    mipi_display_vblank_wait(display_config);
 
-#if HAGL_HAL_PIXEL_SIZE==1
     /* Flush the current back buffer. */
-    return mipi_display_write_xywh(0, 0, bb.width, bb.height, (uint8_t *) buffer);
-#endif /* HAGL_HAL_PIXEL_SIZE==1 */
+    return write_rect(display_config, 0, 0, bb->width, bb->height, buffer, bb->pitch);
+#endif /* HAGL_HAL_USE_ROW_HASH */
+}
 
-#if HAGL_HAL_PIXEL_SIZE==2
-    static hagl_color_t line[MIPI_DISPLAY_WIDTH];
+static size_t
+flush_back_buffer(const void *self)
+{
+#ifdef HAGL_HAL_USE_COUNTERS
+    uint64_t start = time_us_64();
+    size_t sent = send_back_buffer(self);
+    mipi_display_count_flush(GET_MIPI_DISPLAY_CONFIG(self), start);
+    return sent;
+#else
+    return send_back_buffer(self);
+#endif /* HAGL_HAL_USE_COUNTERS */
+}
 
-    hagl_color_t *ptr = (hagl_color_t *) buffer;
+static size_t
+flush(const void *self)
+{
+    const hagl_backend_t *backend = self;
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(self);
+    hagl_bitmap_t *bb = display_config->bb;
+
+#if defined(HAGL_HAL_USE_MULTICORE)
+    /* Buffer we flip to must not be in flight anymore. */
+    size_t sent = mipi_display_wait(display_config);
+#elif defined(HAGL_HAL_USE_TE_FLUSH)
+    /* Buffer we flip to must not be in flight anymore. */
+    size_t sent = mipi_display_vblank_sync(display_config);
+#else
     size_t sent = 0;
+#endif /* HAGL_HAL_USE_MULTICORE */
 
-    for (uint16_t y = 0; y < HAGL_PICO_MIPI_DISPLAY_HEIGHT; y++) {
-        for (uint16_t x = 0; x < HAGL_PICO_MIPI_DISPLAY_WIDTH; x++) {
-            line[x * 2] = *(ptr);
-            line[x * 2 + 1] = *(ptr++);
-        }
-        sent += mipi_display_write_xywh(0, y * 2, MIPI_DISPLAY_WIDTH, 1, (uint8_t *) line);
-        sent += mipi_display_write_xywh(0, y * 2 + 1, MIPI_DISPLAY_WIDTH, 1, (uint8_t *) line);
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    /* Buffer we flip to might still wait for the bus. */
+    mipi_display_bus_sync(display_config);
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    /* Display stays in low power mode until something is drawn. */
+    if (!display_config->drawn) {
+        return sent;
+    }
+    display_config->drawn = false;
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+    /* Flip the buffers. */
+    if (bb->buffer == backend->buffer) {
+        bb->buffer = backend->buffer2;
+    } else {
+        bb->buffer = backend->buffer;
     }
+
+#if defined(HAGL_HAL_USE_MULTICORE)
+    mipi_display_submit(display_config, flush_back_buffer, self);
     return sent;
-#endif /* HAGL_HAL_PIXEL_SIZE==2 */
+#elif defined(HAGL_HAL_USE_TE_FLUSH)
+    /* Started from the TE interrupt, rendering continues meanwhile. */
+    mipi_display_vblank_submit(display_config, flush_back_buffer, self);
+    return sent;
+#else
+    return sent + flush_back_buffer(self);
+#endif /* HAGL_HAL_USE_MULTICORE */
+}
+
+#ifdef HAGL_HAL_USE_FENCE
+mipi_display_fence_t
+hagl_hal_flush_async(hagl_backend_t *backend)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+
+    flush(backend);
+    return mipi_display_fence(display_config);
+}
+#endif /* HAGL_HAL_USE_FENCE */
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+void
+hagl_hal_set_palette(hagl_backend_t *backend, const hagl_color_t *palette, uint16_t count)
+{
+    mipi_display_config_t *display_config = GET_MIPI_DISPLAY_CONFIG(backend);
+
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+    hagl_hal_indexed_palette(display_config, palette, count);
+
+#ifdef HAGL_HAL_USE_ROW_HASH
+    /* Every pixel might have changed. */
+    display_config->row_hash_valid = false;
+#endif /* HAGL_HAL_USE_ROW_HASH */
+}
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+void
+hagl_hal_power_mode(hagl_backend_t *backend, uint8_t mode, const hagl_window_t *area)
+{
+    mipi_display_power_mode(GET_MIPI_DISPLAY_CONFIG(backend), mode, area);
+}
+
+void
+hagl_hal_power_time(hagl_backend_t *backend, uint64_t *time)
+{
+    mipi_display_power_time(GET_MIPI_DISPLAY_CONFIG(backend), time);
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+/* Record that the back buffer was drawn to. */
+static inline void
+damage(const void *self)
+{
+#ifdef HAGL_HAL_USE_LOW_POWER
+    (GET_MIPI_DISPLAY_CONFIG(self))->drawn = true;
+#else
+    (void) self;
+#endif /* HAGL_HAL_USE_LOW_POWER */
 }
 
 static void
-put_pixel(void *self, int16_t x0, int16_t y0, hagl_color_t color)
+put_pixel(const void *self, int16_t x0, int16_t y0, hagl_color_t color)
 {
-    bb.put_pixel(&bb, x0, y0, color);
+    hagl_bitmap_t *bb = GET_BB(self);
+    bb->put_pixel(bb, x0, y0, color);
+    damage(self);
 }
 
 static hagl_color_t
-get_pixel(void *self, int16_t x0, int16_t y0)
+get_pixel(const void *self, int16_t x0, int16_t y0)
 {
-    return bb.get_pixel(&bb, x0, y0);
+    hagl_bitmap_t *bb = GET_BB(self);
+    return bb->get_pixel(bb, x0, y0);
 }
 
 static void
-blit(void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+blit(const void *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
 {
-    bb.blit(&bb, x0, y0, src);
+    hagl_bitmap_t *bb = GET_BB(self);
+    bb->blit(bb, x0, y0, src);
+    damage(self);
 }
 
 static void
-scale_blit(void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+scale_blit(const void *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
 {
-    bb.scale_blit(&bb, x0, y0, w, h, src);
+    hagl_bitmap_t *bb = GET_BB(self);
+    bb->scale_blit(bb, x0, y0, w, h, src);
+    damage(self);
 }
 
 static void
-hline(void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+hline(const void *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
 {
-    bb.hline(&bb, x0, y0, width, color);
+    hagl_bitmap_t *bb = GET_BB(self);
+    bb->hline(bb, x0, y0, width, color);
+    damage(self);
 }
 
 static void
-vline(void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+vline(const void *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
 {
-    bb.vline(&bb, x0, y0, height, color);
+    hagl_bitmap_t *bb = GET_BB(self);
+    bb->vline(bb, x0, y0, height, color);
+    damage(self);
 }
 
 void
-hagl_hal_init(hagl_backend_t *backend)
+hagl_hal_triple_init(hagl_backend_t *backend)
 {
-    mipi_display_init();
+    mipi_display_config_t *display_config = (mipi_display_config_t *)backend->display_config;
+
+    display_config->prev_clip.x0 = 0;
+    display_config->prev_clip.x1 = 0;
+    display_config->prev_clip.y0 = 0;
+    display_config->prev_clip.y1 = 0;
+
+    /* Back buffers are smaller than the display when pixel size is over one. */
+    backend->width = display_config->width / HAGL_HAL_PIXEL_SIZE;
+    backend->height = display_config->height / HAGL_HAL_PIXEL_SIZE;
+    backend->depth = display_config->depth;
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+    size_t size = hagl_hal_indexed_size(backend->width, backend->height);
+#else
+    size_t size = backend->width * backend->height * (backend->depth / 8);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
 
     if (!backend->buffer) {
-        backend->buffer = calloc(HAGL_PICO_MIPI_DISPLAY_WIDTH * HAGL_PICO_MIPI_DISPLAY_HEIGHT * (HAGL_PICO_MIPI_DISPLAY_DEPTH / 8), sizeof(uint8_t));
+        backend->buffer = hagl_hal_buffer_calloc(display_config, 0, size, calloc);
         hagl_hal_debug("Allocated first back buffer to address %p.\n", (void *) backend->buffer);
     } else {
         hagl_hal_debug("Using provided first back buffer at address %p.\n", (void *) backend->buffer);
     }
 
     if (!backend->buffer2) {
-        backend->buffer2 = calloc(HAGL_PICO_MIPI_DISPLAY_WIDTH * HAGL_PICO_MIPI_DISPLAY_HEIGHT * (HAGL_PICO_MIPI_DISPLAY_DEPTH / 8), sizeof(uint8_t));
+        backend->buffer2 = hagl_hal_buffer_calloc(display_config, 1, size, calloc);
         hagl_hal_debug("Allocated second back buffer to address %p.\n", (void *) backend->buffer2);
     } else {
         hagl_hal_debug("Using provided second back buffer at address %p.\n", (void *) backend->buffer2);
     }
 
-    backend->width = HAGL_PICO_MIPI_DISPLAY_WIDTH;
-    backend->height = HAGL_PICO_MIPI_DISPLAY_HEIGHT;
-    backend->depth = HAGL_PICO_MIPI_DISPLAY_DEPTH;
+#if defined(HAGL_HAL_USE_INDEXED_COLOR) || HAGL_HAL_PIXEL_SIZE > 1
+    /* Two display wide lines, one is expanded while the other is sent. */
+    display_config->line_buffer[0] = hagl_hal_buffer_calloc(display_config, 0, display_config->width * 2 * sizeof(hagl_color_t), calloc);
+    display_config->line_buffer[1] = display_config->line_buffer[0] + display_config->width;
+    hagl_hal_debug("Allocated line buffers to address %p.\n", (void *) display_config->line_buffer[0]);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR || HAGL_HAL_PIXEL_SIZE > 1 */
+
     backend->put_pixel = put_pixel;
     backend->get_pixel = get_pixel;
     backend->hline = hline;
@@ -169,7 +441,35 @@ hagl_hal_init(hagl_backend_t *backend)
     backend->flush = flush;
 
     /* Initially use the first buffer. */
-    hagl_bitmap_init(&bb, backend->width, backend->height, backend->depth, backend->buffer);
+    display_config->bb = calloc(1, sizeof(hagl_bitmap_t));
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+    hagl_hal_indexed_init(display_config->bb, backend->width, backend->height, backend->buffer);
+#else
+    hagl_bitmap_init(display_config->bb, backend->width, backend->height, backend->depth, backend->buffer);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    /* GRAM content is unknown so the first flush sends everything. */
+    display_config->drawn = true;
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_ROW_HASH
+    display_config->row_hash_count = (backend->height + HAGL_HAL_ROW_HASH_BAND - 1) / HAGL_HAL_ROW_HASH_BAND;
+    display_config->row_hash = calloc(display_config->row_hash_count, sizeof(uint32_t));
+    display_config->row_changed = calloc(display_config->row_hash_count, sizeof(uint8_t));
+    /* GRAM content is unknown so the first flush sends everything. */
+    display_config->row_hash_valid = false;
+    row_hash_init(display_config);
+#endif /* HAGL_HAL_USE_ROW_HASH */
+}
+
+#ifndef HAGL_HAL_USE_RUNTIME_BUFFER
+void
+hagl_hal_init(hagl_backend_t *backend)
+{
+    mipi_display_init((mipi_display_config_t *)backend->display_config);
+    hagl_hal_triple_init(backend);
 }
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
 
-#endif /* HAGL_HAL_USE_TRIPLE_BUFFER */
+#endif /* HAGL_HAL_USE_TRIPLE_BUFFER || HAGL_HAL_USE_RUNTIME_BUFFER */
@@ -0,0 +1,552 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Runs the HAGL primitive benchmarks from the README speed table against
+the host stand-in of the Pico SDK and prints one row per primitive as CSV
+or JSON lines. Buffering is selected at compile time, see CMakeLists.txt.
+Time is modelled, see pico_host.h. Drawing on the CPU costs a fixed time
+per backend call and per pixel.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <hagl.h>
+#include <font6x9.h>
+
+#include "hagl_hal.h"
+#include "mipi_dcs.h"
+#include "mipi_display.h"
+#include "pico_host.h"
+
+#ifndef HAGL_HAL_BENCH_NAME
+#define HAGL_HAL_BENCH_NAME     "Unknown"
+#endif
+
+/* Times are in nanoseconds. */
+typedef struct {
+    uint32_t    seconds;
+    uint32_t    fps;
+    uint32_t    call_ns;
+    uint32_t    pixel_ns;
+    uint8_t     format;
+    bool        header;
+} bench_options_t;
+
+typedef struct {
+    const char  *name;
+    void        (*run)(hagl_backend_t *display);
+} bench_t;
+
+static mipi_display_config_t display_config = {
+    .spi_freq = MIPI_DISPLAY_SPI_CLOCK_SPEED_HZ,
+    .spi = MIPI_DISPLAY_SPI_PORT,
+    .pin_cs = MIPI_DISPLAY_PIN_CS,
+    .pin_dc = MIPI_DISPLAY_PIN_DC,
+    .pin_rst = MIPI_DISPLAY_PIN_RST,
+    .pin_bl = MIPI_DISPLAY_PIN_BL,
+    .pin_clk = MIPI_DISPLAY_PIN_CLK,
+    .pin_mosi = MIPI_DISPLAY_PIN_MOSI,
+    .pin_miso = MIPI_DISPLAY_PIN_MISO,
+    .pin_power = MIPI_DISPLAY_PIN_POWER,
+    .pin_te = MIPI_DISPLAY_PIN_TE,
+    .pixel_format = MIPI_DISPLAY_PIXEL_FORMAT,
+    .address_mode = MIPI_DISPLAY_ADDRESS_MODE,
+    .width = MIPI_DISPLAY_WIDTH,
+    .height = MIPI_DISPLAY_HEIGHT,
+    .offset_x = MIPI_DISPLAY_OFFSET_X,
+    .offset_y = MIPI_DISPLAY_OFFSET_Y,
+    .depth = MIPI_DISPLAY_DEPTH,
+    .invert = MIPI_DISPLAY_INVERT,
+    .init_spi = 1,
+};
+
+static hagl_backend_t backend;
+static hagl_backend_t hal;
+static bench_options_t options = {
+    .seconds = 2,
+    .fps = 30,
+    .call_ns = 400,
+    .pixel_ns = 16,
+    .format = MIPI_DISPLAY_COUNTERS_CSV,
+    .header = true,
+};
+
+/* Same sequence on every run so that the byte counts can be compared. */
+static uint32_t seed;
+
+static int16_t
+rnd(int16_t max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % max;
+}
+
+static hagl_color_t
+random_color(hagl_backend_t *display)
+{
+    return hagl_color(display, rnd(256), rnd(256), rnd(256));
+}
+
+/* Drawing itself costs time on the device too. */
+static void
+cpu(uint32_t pixels)
+{
+    pico_host_advance(options.call_ns + (uint64_t) pixels * options.pixel_ns);
+}
+
+static void
+put_pixel(void const *self, int16_t x0, int16_t y0, hagl_color_t color)
+{
+    cpu(1);
+    hal.put_pixel(self, x0, y0, color);
+}
+
+static void
+hline(void const *self, int16_t x0, int16_t y0, uint16_t width, hagl_color_t color)
+{
+    cpu(width);
+    hal.hline(self, x0, y0, width, color);
+}
+
+static void
+vline(void const *self, int16_t x0, int16_t y0, uint16_t height, hagl_color_t color)
+{
+    cpu(height);
+    hal.vline(self, x0, y0, height, color);
+}
+
+static void
+blit(void const *self, int16_t x0, int16_t y0, hagl_bitmap_t *src)
+{
+    cpu(src->width * src->height);
+    hal.blit(self, x0, y0, src);
+}
+
+static void
+scale_blit(void const *self, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, hagl_bitmap_t *src)
+{
+    cpu(w * h);
+    hal.scale_blit(self, x0, y0, w, h, src);
+}
+
+static void
+bench_put_pixel(hagl_backend_t *display)
+{
+    hagl_put_pixel(display, rnd(display->width), rnd(display->height), random_color(display));
+}
+
+static void
+bench_draw_line(hagl_backend_t *display)
+{
+    hagl_draw_line(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        random_color(display)
+    );
+}
+
+static void
+bench_draw_vline(hagl_backend_t *display)
+{
+    hagl_draw_vline(
+        display, rnd(display->width), rnd(display->height), rnd(display->height / 2), random_color(display)
+    );
+}
+
+static void
+bench_draw_hline(hagl_backend_t *display)
+{
+    hagl_draw_hline(
+        display, rnd(display->width), rnd(display->height), rnd(display->width / 2), random_color(display)
+    );
+}
+
+static void
+bench_draw_circle(hagl_backend_t *display)
+{
+    hagl_draw_circle(
+        display, rnd(display->width), rnd(display->height), rnd(display->width / 4), random_color(display)
+    );
+}
+
+static void
+bench_fill_circle(hagl_backend_t *display)
+{
+    hagl_fill_circle(
+        display, rnd(display->width), rnd(display->height), rnd(display->width / 4), random_color(display)
+    );
+}
+
+static void
+bench_draw_ellipse(hagl_backend_t *display)
+{
+    hagl_draw_ellipse(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width / 4), rnd(display->height / 4),
+        random_color(display)
+    );
+}
+
+static void
+bench_fill_ellipse(hagl_backend_t *display)
+{
+    hagl_fill_ellipse(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width / 4), rnd(display->height / 4),
+        random_color(display)
+    );
+}
+
+static void
+bench_draw_triangle(hagl_backend_t *display)
+{
+    hagl_draw_triangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        random_color(display)
+    );
+}
+
+static void
+bench_fill_triangle(hagl_backend_t *display)
+{
+    hagl_fill_triangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        random_color(display)
+    );
+}
+
+static void
+bench_draw_rectangle(hagl_backend_t *display)
+{
+    hagl_draw_rectangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        random_color(display)
+    );
+}
+
+static void
+bench_fill_rectangle(hagl_backend_t *display)
+{
+    hagl_fill_rectangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        random_color(display)
+    );
+}
+
+static void
+bench_draw_rounded_rectangle(hagl_backend_t *display)
+{
+    hagl_draw_rounded_rectangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        rnd(10), random_color(display)
+    );
+}
+
+static void
+bench_fill_rounded_rectangle(hagl_backend_t *display)
+{
+    hagl_fill_rounded_rectangle(
+        display,
+        rnd(display->width), rnd(display->height),
+        rnd(display->width), rnd(display->height),
+        rnd(10), random_color(display)
+    );
+}
+
+static void
+polygon(int16_t *vertices, hagl_backend_t *display)
+{
+    for (uint8_t i = 0; i < 10; i += 2) {
+        vertices[i] = rnd(display->width);
+        vertices[i + 1] = rnd(display->height);
+    }
+}
+
+static void
+bench_draw_polygon(hagl_backend_t *display)
+{
+    int16_t vertices[10];
+    polygon(vertices, display);
+    hagl_draw_polygon(display, 5, vertices, random_color(display));
+}
+
+static void
+bench_fill_polygon(hagl_backend_t *display)
+{
+    int16_t vertices[10];
+    polygon(vertices, display);
+    hagl_fill_polygon(display, 5, vertices, random_color(display));
+}
+
+static void
+bench_put_char(hagl_backend_t *display)
+{
+    hagl_put_char(
+        display, L'A' + rnd(26), rnd(display->width), rnd(display->height), random_color(display), font6x9
+    );
+}
+
+static void
+bench_put_text(hagl_backend_t *display)
+{
+    hagl_put_text(
+        display, L"YO! MTV raps.", rnd(display->width), rnd(display->height), random_color(display), font6x9
+    );
+}
+
+static const bench_t benchmarks[] = {
+    {"hagl_put_pixel", bench_put_pixel},
+    {"hagl_draw_line", bench_draw_line},
+    {"hagl_draw_vline", bench_draw_vline},
+    {"hagl_draw_hline", bench_draw_hline},
+    {"hagl_draw_circle", bench_draw_circle},
+    {"hagl_fill_circle", bench_fill_circle},
+    {"hagl_draw_ellipse", bench_draw_ellipse},
+    {"hagl_fill_ellipse", bench_fill_ellipse},
+    {"hagl_draw_triangle", bench_draw_triangle},
+    {"hagl_fill_triangle", bench_fill_triangle},
+    {"hagl_draw_rectangle", bench_draw_rectangle},
+    {"hagl_fill_rectangle", bench_fill_rectangle},
+    {"hagl_draw_rounded_rectangle", bench_draw_rounded_rectangle},
+    {"hagl_fill_rounded_rectangle", bench_fill_rounded_rectangle},
+    {"hagl_draw_polygon", bench_draw_polygon},
+    {"hagl_fill_polygon", bench_fill_polygon},
+    {"hagl_put_char", bench_put_char},
+    {"hagl_put_text", bench_put_text},
+};
+
+static void
+print_header(void)
+{
+    if (MIPI_DISPLAY_COUNTERS_CSV == options.format && options.header) {
+        printf(
+            "buffering,primitive,ops,ops_per_second,spi_bytes,pixel_bytes,command_bytes,"
+            "commands,window_changes,window_hits,frames,bus_busy_percent,gpio_writes,dma_transfers\n"
+        );
+    }
+}
+
+static void
+print_row(const char *name, uint32_t ops, uint64_t elapsed)
+{
+    mipi_display_counters_t counters;
+    pico_host_stats_t stats;
+
+    mipi_display_counters(&display_config, &counters);
+    pico_host_stats(&stats);
+
+    uint32_t ops_per_second = (uint64_t) ops * 1000000000 / elapsed;
+    uint32_t busy = stats.spi_busy_ns * 100 / elapsed;
+
+    if (MIPI_DISPLAY_COUNTERS_JSON == options.format) {
+        printf(
+            "{\"buffering\": \"%s\", \"primitive\": \"%s\", \"ops\": %lu, \"ops_per_second\": %lu, "
+            "\"spi_bytes\": %llu, \"pixel_bytes\": %llu, \"command_bytes\": %llu, "
+            "\"commands\": %lu, \"window_changes\": %lu, \"window_hits\": %lu, \"frames\": %lu, "
+            "\"bus_busy_percent\": %lu, \"gpio_writes\": %lu, \"dma_transfers\": %lu}\n",
+            HAGL_HAL_BENCH_NAME, name, (unsigned long) ops, (unsigned long) ops_per_second,
+            (unsigned long long) (stats.spi_bits / 8),
+            (unsigned long long) counters.pixel_bytes, (unsigned long long) counters.command_bytes,
+            (unsigned long) counters.commands, (unsigned long) counters.window_changes, (unsigned long) counters.window_hits,
+            (unsigned long) counters.frames, (unsigned long) busy,
+            (unsigned long) stats.gpio_writes, (unsigned long) stats.dma_transfers
+        );
+        return;
+    }
+
+    printf(
+        "%s,%s,%lu,%lu,%llu,%llu,%llu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+        HAGL_HAL_BENCH_NAME, name, (unsigned long) ops, (unsigned long) ops_per_second,
+        (unsigned long long) (stats.spi_bits / 8),
+        (unsigned long long) counters.pixel_bytes, (unsigned long long) counters.command_bytes,
+        (unsigned long) counters.commands, (unsigned long) counters.window_changes, (unsigned long) counters.window_hits,
+        (unsigned long) counters.frames, (unsigned long) busy,
+        (unsigned long) stats.gpio_writes, (unsigned long) stats.dma_transfers
+    );
+}
+
+/*
+ * Each primitive is drawn for the given time. Buffered displays are
+ * flushed at the given rate like in the tests on the device.
+ */
+static void
+run(hagl_backend_t *display, const bench_t *bench)
+{
+    uint64_t frame = 1000000000 / options.fps;
+    uint64_t duration = options.seconds * 1000000000ULL;
+    uint32_t ops = 0;
+
+    seed = 1;
+    hagl_clear(display);
+    if (display->flush) {
+        hagl_flush(display);
+    }
+    pico_host_drain();
+
+    mipi_display_counters_reset(&display_config);
+    pico_host_stats_reset();
+
+    uint64_t start = pico_host_time_ns();
+    uint64_t next = start + frame;
+
+    while (pico_host_time_ns() - start < duration) {
+        bench->run(display);
+        ops++;
+
+        if (display->flush && pico_host_time_ns() >= next) {
+            hagl_flush(display);
+            next += frame;
+        }
+    }
+
+    if (display->flush) {
+        hagl_flush(display);
+    }
+    mipi_display_sync(&display_config);
+    pico_host_drain();
+
+    print_row(bench->name, ops, pico_host_time_ns() - start);
+}
+
+static void
+usage(const char *name)
+{
+    fprintf(
+        stderr,
+        "usage: %s [--csv | --json] [--no-header] [--seconds N] [--fps N]\n"
+        "       [--spi-hz N] [--clk-peri N] [--fifo N] [--gpio-ns N] [--register-ns N]\n"
+        "       [--dma-ns N] [--call-ns N] [--pixel-ns N] [primitive ...]\n",
+        name
+    );
+    exit(EXIT_FAILURE);
+}
+
+static uint32_t
+value(int argc, char *argv[], int *i)
+{
+    if (*i + 1 >= argc) {
+        usage(argv[0]);
+    }
+    return strtoul(argv[++(*i)], NULL, 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *only[sizeof(benchmarks) / sizeof(bench_t)];
+    size_t only_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--csv")) {
+            options.format = MIPI_DISPLAY_COUNTERS_CSV;
+        } else if (0 == strcmp(argv[i], "--json")) {
+            options.format = MIPI_DISPLAY_COUNTERS_JSON;
+        } else if (0 == strcmp(argv[i], "--no-header")) {
+            options.header = false;
+        } else if (0 == strcmp(argv[i], "--seconds")) {
+            options.seconds = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--fps")) {
+            options.fps = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--spi-hz")) {
+            display_config.spi_freq = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--clk-peri")) {
+            pico_host_cost.clk_peri = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--fifo")) {
+            pico_host_cost.fifo_depth = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--gpio-ns")) {
+            pico_host_cost.gpio_ns = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--register-ns")) {
+            pico_host_cost.register_ns = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--dma-ns")) {
+            pico_host_cost.dma_start_ns = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--call-ns")) {
+            options.call_ns = value(argc, argv, &i);
+        } else if (0 == strcmp(argv[i], "--pixel-ns")) {
+            options.pixel_ns = value(argc, argv, &i);
+        } else if ('-' == argv[i][0] || only_count == sizeof(only) / sizeof(only[0])) {
+            usage(argv[0]);
+        } else {
+            only[only_count++] = argv[i];
+        }
+    }
+
+    if (0 == options.seconds || 0 == options.fps || 0 == pico_host_cost.fifo_depth) {
+        usage(argv[0]);
+    }
+
+    backend.display_config = &display_config;
+    backend.haglCalloc = calloc;
+    hagl_hal_init(&backend);
+    hagl_set_clip(&backend, 0, 0, backend.width - 1, backend.height - 1);
+
+    /* Drawing through the backend is charged to the CPU. */
+    hal = backend;
+    backend.put_pixel = put_pixel;
+    backend.hline = hline;
+    backend.vline = vline;
+    backend.blit = hal.blit ? blit : NULL;
+    backend.scale_blit = hal.scale_blit ? scale_blit : NULL;
+
+    print_header();
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(bench_t); i++) {
+        bool selected = 0 == only_count;
+        for (size_t j = 0; j < only_count; j++) {
+            selected |= 0 == strcmp(only[j], benchmarks[i].name);
+        }
+        if (selected) {
+            run(&backend, &benchmarks[i]);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
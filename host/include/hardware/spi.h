@@ -0,0 +1,93 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Registers are plain memory. Each spi_get_hw() call first sends a frame
+written to DR since the previous call and then updates SR from the model.
+
+*/
+
+#ifndef _HARDWARE_SPI_H
+#define _HARDWARE_SPI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+typedef struct {
+    volatile uint32_t cr0, cr1, dr, sr, cpsr, imsc, ris, mis, icr, dmacr;
+} spi_hw_t;
+
+typedef struct spi_inst {
+    spi_hw_t    hw;
+    uint        baudrate;
+    uint        data_bits;
+    double      busy_until;
+} spi_inst_t;
+
+extern spi_inst_t pico_host_spi[2];
+
+#define spi0    (&pico_host_spi[0])
+#define spi1    (&pico_host_spi[1])
+
+#define SPI_SSPSR_TNF_BITS      (0x02)
+#define SPI_SSPSR_RNE_BITS      (0x04)
+#define SPI_SSPSR_BSY_BITS      (0x10)
+#define SPI_SSPICR_RORIC_BITS   (0x01)
+
+typedef enum { SPI_CPOL_0, SPI_CPOL_1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0, SPI_CPHA_1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST, SPI_MSB_FIRST } spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_index(const spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+bool spi_is_writable(const spi_inst_t *spi);
+bool spi_is_busy(const spi_inst_t *spi);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _HARDWARE_SPI_H */
@@ -0,0 +1,86 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Stand-in for the parts of the Pico SDK used by the HAL so that it can be
+compiled and benchmarked on a host. Nothing is sent anywhere. Time is
+virtual and advanced by a cost model of the SPI clock, the TX FIFO, GPIO
+writes and register accesses. Bytes sent on the wire are counted.
+
+*/
+
+#ifndef _PICO_HOST_H
+#define _PICO_HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Times are in nanoseconds. */
+typedef struct {
+    uint32_t    clk_peri;       /* SPI clock is divided from this, Hz */
+    uint8_t     fifo_depth;     /* SPI TX FIFO entries */
+    uint32_t    gpio_ns;        /* each gpio_put() */
+    uint32_t    register_ns;    /* each SPI or DMA register access and status poll */
+    uint32_t    dma_start_ns;   /* configuring and starting a DMA transfer */
+} pico_host_cost_t;
+
+typedef struct {
+    uint64_t    spi_bits;       /* bits shifted out, all ports */
+    uint64_t    spi_frames;     /* FIFO entries written */
+    uint64_t    spi_busy_ns;    /* time the ports were shifting */
+    uint32_t    gpio_writes;
+    uint32_t    dma_transfers;
+} pico_host_stats_t;
+
+/* Defaults model RP2040 at 125 MHz. Change before the display is initialised. */
+extern pico_host_cost_t pico_host_cost;
+
+/* Virtual time since start. */
+uint64_t pico_host_time_ns(void);
+
+/* Spend time on the CPU, for example for drawing. */
+void pico_host_advance(uint64_t ns);
+
+/* Wait until all SPI ports and DMA channels are idle. */
+void pico_host_drain(void);
+
+void pico_host_stats(pico_host_stats_t *stats);
+void pico_host_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _PICO_HOST_H */
@@ -0,0 +1,572 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Cost model behind the Pico SDK stand-in. SPI ports shift frames out at
+the configured clock from a FIFO of given depth. Writing to a full FIFO
+or waiting for an idle port advances the virtual time.
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico_host.h"
+#include "pico/time.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+
+#define PICO_HOST_DMA_CHANNELS  (12)
+#define PICO_HOST_GPIOS         (30)
+
+/* Written to DR after each access to notice the next write. */
+#define PICO_HOST_DR_EMPTY      (0xffffffff)
+
+typedef struct {
+    bool        claimed;
+    dma_channel_config config;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint32_t    count;
+    double      busy_until;
+} pico_host_dma_t;
+
+pico_host_cost_t pico_host_cost = {
+    .clk_peri = 125000000,
+    .fifo_depth = 8,
+    .gpio_ns = 24,
+    .register_ns = 16,
+    .dma_start_ns = 200,
+};
+
+spi_inst_t pico_host_spi[2];
+
+static double now;
+/* Port or channel which was busy on the previous poll. */
+static const void *poll;
+static pico_host_stats_t stats;
+static pico_host_dma_t dma[PICO_HOST_DMA_CHANNELS];
+static bool gpio_level[PICO_HOST_GPIOS];
+
+static double
+frame_ns(const spi_inst_t *spi)
+{
+    return spi->data_bits * 1e9 / spi->baudrate;
+}
+
+/* Frames waiting in the FIFO and the one being shifted out. */
+static uint32_t
+fifo_level(const spi_inst_t *spi)
+{
+    if (spi->busy_until <= now) {
+        return 0;
+    }
+    return (uint32_t) ceil((spi->busy_until - now) / frame_ns(spi));
+}
+
+/* Queue frames, returns when the last one has entered the FIFO. */
+static void
+spi_push(spi_inst_t *spi, uint32_t frames)
+{
+    double start = spi->busy_until > now ? spi->busy_until : now;
+    double length = frames * frame_ns(spi);
+
+    spi->busy_until = start + length;
+    stats.spi_bits += (uint64_t) frames * spi->data_bits;
+    stats.spi_frames += frames;
+    stats.spi_busy_ns += (uint64_t) length;
+}
+
+/* Send a frame which was written directly to DR. */
+static void
+spi_sync(spi_inst_t *spi)
+{
+    if (spi->baudrate && PICO_HOST_DR_EMPTY != spi->hw.dr) {
+        /* Writing to a full FIFO stalls until there is room. */
+        double room = spi->busy_until - pico_host_cost.fifo_depth * frame_ns(spi);
+        if (room > now) {
+            now = room;
+        }
+        spi_push(spi, 1);
+        spi->hw.dr = PICO_HOST_DR_EMPTY;
+    }
+}
+
+static void
+spi_sync_all(void)
+{
+    poll = NULL;
+    spi_sync(spi0);
+    spi_sync(spi1);
+}
+
+uint64_t
+pico_host_time_ns(void)
+{
+    spi_sync_all();
+    return (uint64_t) now;
+}
+
+void
+pico_host_advance(uint64_t ns)
+{
+    spi_sync_all();
+    now += ns;
+}
+
+void
+pico_host_drain(void)
+{
+    spi_sync_all();
+    for (uint8_t i = 0; i < 2; i++) {
+        if (pico_host_spi[i].busy_until > now) {
+            now = pico_host_spi[i].busy_until;
+        }
+    }
+    for (uint8_t i = 0; i < PICO_HOST_DMA_CHANNELS; i++) {
+        if (dma[i].busy_until > now) {
+            now = dma[i].busy_until;
+        }
+    }
+}
+
+void
+pico_host_stats(pico_host_stats_t *copy)
+{
+    spi_sync_all();
+    *copy = stats;
+}
+
+void
+pico_host_stats_reset(void)
+{
+    spi_sync_all();
+    memset(&stats, 0, sizeof(pico_host_stats_t));
+}
+
+/* Time */
+
+uint64_t
+time_us_64(void)
+{
+    return pico_host_time_ns() / 1000;
+}
+
+uint32_t
+time_us_32(void)
+{
+    return (uint32_t) time_us_64();
+}
+
+absolute_time_t
+get_absolute_time(void)
+{
+    return time_us_64();
+}
+
+absolute_time_t
+make_timeout_time_ms(uint32_t ms)
+{
+    return time_us_64() + ms * 1000ULL;
+}
+
+int64_t
+absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return (int64_t) (to - from);
+}
+
+void
+sleep_us(uint64_t us)
+{
+    pico_host_advance(us * 1000);
+}
+
+void
+sleep_ms(uint32_t ms)
+{
+    sleep_us(ms * 1000ULL);
+}
+
+void
+busy_wait_us(uint64_t us)
+{
+    sleep_us(us);
+}
+
+void
+sleep_until(absolute_time_t target)
+{
+    uint64_t current = time_us_64();
+    if (target > current) {
+        sleep_us(target - current);
+    }
+}
+
+uint32_t
+clock_get_hz(enum clock_index clk_index)
+{
+    return clk_peri == clk_index ? pico_host_cost.clk_peri : 125000000;
+}
+
+/* GPIO */
+
+void gpio_init(uint gpio) { (void) gpio; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void) gpio; (void) fn; }
+void gpio_set_dir(uint gpio, bool out) { (void) gpio; (void) out; }
+void gpio_pull_up(uint gpio) { gpio_level[gpio % PICO_HOST_GPIOS] = true; }
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) { (void) gpio; (void) events; (void) enabled; }
+void gpio_add_raw_irq_handler(uint gpio, void (*handler)(void)) { (void) gpio; (void) handler; }
+uint32_t gpio_get_irq_event_mask(uint gpio) { (void) gpio; return 0; }
+void gpio_acknowledge_irq(uint gpio, uint32_t events) { (void) gpio; (void) events; }
+
+void
+gpio_put(uint gpio, bool value)
+{
+    spi_sync_all();
+    now += pico_host_cost.gpio_ns;
+    stats.gpio_writes++;
+    gpio_level[gpio % PICO_HOST_GPIOS] = value;
+}
+
+bool
+gpio_get(uint gpio)
+{
+    return gpio_level[gpio % PICO_HOST_GPIOS];
+}
+
+/* SPI */
+
+/* Clock is divided by an even prescaler and a postdivider like on RP2040. */
+uint
+spi_set_baudrate(spi_inst_t *spi, uint baudrate)
+{
+    uint32_t freq = pico_host_cost.clk_peri;
+    uint32_t prescale;
+    uint32_t postdiv;
+
+    for (prescale = 2; prescale <= 254; prescale += 2) {
+        if ((uint64_t) freq < (uint64_t) (prescale + 2) * 256 * baudrate) {
+            break;
+        }
+    }
+    for (postdiv = 256; postdiv > 1; --postdiv) {
+        if (freq / (prescale * (postdiv - 1)) > baudrate) {
+            break;
+        }
+    }
+
+    spi->baudrate = freq / (prescale * postdiv);
+    return spi->baudrate;
+}
+
+uint
+spi_init(spi_inst_t *spi, uint baudrate)
+{
+    spi->hw.dr = PICO_HOST_DR_EMPTY;
+    spi->data_bits = 8;
+    spi->busy_until = now;
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void
+spi_deinit(spi_inst_t *spi)
+{
+    spi->baudrate = 0;
+}
+
+uint
+spi_get_baudrate(const spi_inst_t *spi)
+{
+    return spi->baudrate;
+}
+
+void
+spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order)
+{
+    (void) cpol;
+    (void) cpha;
+    (void) order;
+
+    spi_sync(spi);
+    now += pico_host_cost.register_ns;
+    spi->data_bits = data_bits;
+}
+
+/*
+ * Polling SR again without writing anything in between means the CPU is
+ * spinning until the port is idle. Time jumps there instead of looping.
+ */
+spi_hw_t *
+spi_get_hw(spi_inst_t *spi)
+{
+    bool spinning = poll == spi && PICO_HOST_DR_EMPTY == spi->hw.dr;
+
+    spi_sync(spi);
+    if (spinning && spi->busy_until > now) {
+        now = spi->busy_until;
+    }
+    now += pico_host_cost.register_ns;
+
+    uint32_t sr = 0;
+    if (spi->busy_until > now) {
+        sr |= SPI_SSPSR_BSY_BITS;
+    }
+    if (fifo_level(spi) <= pico_host_cost.fifo_depth) {
+        sr |= SPI_SSPSR_TNF_BITS;
+    }
+    spi->hw.sr = sr;
+    poll = (sr & SPI_SSPSR_BSY_BITS) ? spi : NULL;
+
+    return &spi->hw;
+}
+
+uint
+spi_get_index(const spi_inst_t *spi)
+{
+    return spi == spi1 ? 1 : 0;
+}
+
+uint
+spi_get_dreq(spi_inst_t *spi, bool is_tx)
+{
+    return (spi == spi1 ? DREQ_SPI1_TX : DREQ_SPI0_TX) + (is_tx ? 0 : 1);
+}
+
+/* Full FIFO is waited for by polling, skip to when there is room. */
+bool
+spi_is_writable(const spi_inst_t *spi)
+{
+    spi_sync_all();
+    now += pico_host_cost.register_ns;
+    if (fifo_level(spi) > pico_host_cost.fifo_depth) {
+        now = spi->busy_until - pico_host_cost.fifo_depth * frame_ns(spi);
+        return false;
+    }
+    return true;
+}
+
+bool
+spi_is_busy(const spi_inst_t *spi)
+{
+    bool spinning = poll == spi;
+
+    spi_sync_all();
+    if (spinning && spi->busy_until > now) {
+        now = spi->busy_until;
+    }
+    now += pico_host_cost.register_ns;
+    poll = spi->busy_until > now ? spi : NULL;
+    return NULL != poll;
+}
+
+/* Like the SDK returns only after the last frame has been shifted out. */
+int
+spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    (void) src;
+
+    spi_sync(spi);
+    for (size_t i = 0; i < len; i++) {
+        now += pico_host_cost.register_ns;
+        spi->hw.dr = 0;
+        spi_sync(spi);
+    }
+    if (spi->busy_until > now) {
+        now = spi->busy_until;
+    }
+    return (int) len;
+}
+
+/* Nothing is connected to MISO. */
+int
+spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len)
+{
+    spi_write_blocking(spi, &repeated_tx_data, len);
+    memset(dst, 0xff, len);
+    return (int) len;
+}
+
+/* DMA */
+
+int
+dma_claim_unused_channel(bool required)
+{
+    for (uint8_t i = 0; i < PICO_HOST_DMA_CHANNELS; i++) {
+        if (!dma[i].claimed) {
+            dma[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "No DMA channels available\n");
+        abort();
+    }
+    return -1;
+}
+
+void
+dma_channel_unclaim(uint channel)
+{
+    dma[channel].claimed = false;
+}
+
+dma_channel_config
+dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config config = {
+        .size = DMA_SIZE_32,
+        .read_increment = true,
+        .write_increment = false,
+        .bswap = false,
+        .dreq = DREQ_FORCE,
+        .chain_to = channel,
+        .irq_quiet = false,
+    };
+    return config;
+}
+
+dma_channel_config
+dma_get_channel_config(uint channel)
+{
+    return dma[channel].config;
+}
+
+static void
+dma_start(uint channel)
+{
+    pico_host_dma_t *ch = &dma[channel];
+
+    spi_sync_all();
+    now += pico_host_cost.dma_start_ns;
+    stats.dma_transfers++;
+    ch->busy_until = now;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        spi_inst_t *spi = &pico_host_spi[i];
+        if (ch->write_addr == &spi->hw.dr) {
+            /* Each transfer is one frame. Channel is done when the last is in the FIFO. */
+            spi_push(spi, ch->count);
+            ch->busy_until = spi->busy_until - pico_host_cost.fifo_depth * frame_ns(spi);
+            if (ch->busy_until < now) {
+                ch->busy_until = now;
+            }
+        }
+    }
+}
+
+void
+dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger)
+{
+    dma[channel].config = *config;
+    if (trigger) {
+        dma_start(channel);
+    }
+}
+
+void
+dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger)
+{
+    dma[channel].read_addr = read_addr;
+    if (trigger) {
+        dma_start(channel);
+    }
+}
+
+void
+dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger)
+{
+    dma[channel].write_addr = write_addr;
+    if (trigger) {
+        dma_start(channel);
+    }
+}
+
+void
+dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger)
+{
+    dma[channel].count = trans_count;
+    if (trigger) {
+        dma_start(channel);
+    }
+}
+
+void
+dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma[channel].config = *config;
+    dma[channel].write_addr = write_addr;
+    dma[channel].read_addr = read_addr;
+    dma[channel].count = transfer_count;
+    if (trigger) {
+        dma_start(channel);
+    }
+}
+
+void
+dma_channel_start(uint channel)
+{
+    dma_start(channel);
+}
+
+void
+dma_channel_abort(uint channel)
+{
+    dma[channel].busy_until = now;
+}
+
+bool
+dma_channel_is_busy(uint channel)
+{
+    bool spinning = poll == &dma[channel];
+
+    spi_sync_all();
+    if (spinning && dma[channel].busy_until > now) {
+        now = dma[channel].busy_until;
+    }
+    now += pico_host_cost.register_ns;
+    poll = dma[channel].busy_until > now ? &dma[channel] : NULL;
+    return NULL != poll;
+}
+
+void
+dma_channel_wait_for_finish_blocking(uint channel)
+{
+    spi_sync_all();
+    if (dma[channel].busy_until > now) {
+        now = dma[channel].busy_until;
+    }
+}
@@ -0,0 +1,210 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Feeds a recorded command and data stream to the trace decoder and checks
+the GRAM image, the screen image with scroll start applied and the
+counters of wasted bytes. Exits with non zero status on failure.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mipi_dcs.h"
+#include "mipi_display_trace.h"
+
+#define WIDTH   (4)
+#define HEIGHT  (4)
+
+#define RED     (0xf800)
+#define BLUE    (0x001f)
+
+static int failures = 0;
+
+#define CHECK(expr) \
+    do { if (!(expr)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #expr); failures++; } } while (0)
+
+static void
+command(mipi_display_trace_t *trace, uint8_t command, const uint8_t *params, size_t length)
+{
+    mipi_display_trace_feed(trace, 0, &command, 1, 1);
+    if (length) {
+        mipi_display_trace_feed(trace, 1, params, length, 1);
+    }
+}
+
+static void
+window(mipi_display_trace_t *trace, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    command(trace, MIPI_DCS_SET_COLUMN_ADDRESS, (uint8_t[]) {x0 >> 8, x0 & 0xff, x1 >> 8, x1 & 0xff}, 4);
+    command(trace, MIPI_DCS_SET_PAGE_ADDRESS, (uint8_t[]) {y0 >> 8, y0 & 0xff, y1 >> 8, y1 & 0xff}, 4);
+}
+
+/* Fill is traced as one pixel and a repeat count. */
+static void
+fill(mipi_display_trace_t *trace, uint16_t color, size_t count)
+{
+    command(trace, MIPI_DCS_WRITE_MEMORY_START, NULL, 0);
+    mipi_display_trace_feed(trace, 1, (uint8_t[]) {color >> 8, color & 0xff}, 2, count);
+}
+
+static void
+init(mipi_display_trace_t *trace)
+{
+    command(trace, MIPI_DCS_SOFT_RESET, NULL, 0);
+    command(trace, MIPI_DCS_EXIT_SLEEP_MODE, NULL, 0);
+    command(trace, MIPI_DCS_SET_PIXEL_FORMAT, (uint8_t[]) {MIPI_DCS_PIXEL_FORMAT_16BIT}, 1);
+    command(trace, MIPI_DCS_SET_ADDRESS_MODE, (uint8_t[]) {MIPI_DCS_ADDRESS_MODE_BGR}, 1);
+    command(trace, MIPI_DCS_ENTER_INVERT_MODE, NULL, 0);
+    command(trace, MIPI_DCS_ENTER_NORMAL_MODE, NULL, 0);
+    command(trace, MIPI_DCS_SET_DISPLAY_ON, NULL, 0);
+}
+
+static void
+test_fill(void)
+{
+    static uint16_t gram[WIDTH * HEIGHT];
+    mipi_display_trace_t trace;
+
+    mipi_display_trace_init(&trace, gram, WIDTH, HEIGHT);
+    init(&trace);
+
+    CHECK(7 == trace.stats.commands);
+    CHECK(9 == trace.stats.command_bytes);
+    CHECK(MIPI_DCS_ADDRESS_MODE_BGR == trace.address_mode);
+    CHECK(0 == trace.stats.redundant_commands);
+
+    /* Pixel format is already 16 bit. */
+    command(&trace, MIPI_DCS_SET_PIXEL_FORMAT, (uint8_t[]) {MIPI_DCS_PIXEL_FORMAT_16BIT}, 1);
+    CHECK(1 == trace.stats.redundant_commands);
+    CHECK(2 == trace.stats.redundant_bytes);
+
+    mipi_display_trace_reset(&trace);
+
+    /* Two top rows, last pixel wraps back to the start of the window. */
+    window(&trace, 0, 0, 3, 1);
+    fill(&trace, RED, 9);
+
+    CHECK(9 == trace.stats.pixels);
+    CHECK(18 == trace.stats.pixel_bytes);
+    CHECK(0 == trace.stats.pixels_clipped);
+    for (size_t i = 0; i < 2 * WIDTH; i++) {
+        CHECK(RED == gram[i]);
+    }
+    for (size_t i = 2 * WIDTH; i < WIDTH * HEIGHT; i++) {
+        CHECK(0 == gram[i]);
+    }
+
+    /* Same window again is redundant. */
+    window(&trace, 0, 0, 3, 1);
+    CHECK(2 == trace.stats.redundant_commands);
+    CHECK(10 == trace.stats.redundant_bytes);
+
+    /* Column address which no memory write used. */
+    window(&trace, 1, 2, 1, 2);
+    window(&trace, 2, 3, 2, 3);
+    CHECK(2 == trace.stats.overwritten_commands);
+    CHECK(10 == trace.stats.overwritten_bytes);
+
+    fill(&trace, BLUE, 1);
+    CHECK(BLUE == gram[3 * WIDTH + 2]);
+    CHECK(0 == gram[2 * WIDTH + 1]);
+
+    /* Memory write without pixels and one with half a pixel, both empty. */
+    command(&trace, MIPI_DCS_WRITE_MEMORY_START, NULL, 0);
+    command(&trace, MIPI_DCS_WRITE_MEMORY_START, (uint8_t[]) {0xff}, 1);
+    command(&trace, MIPI_DCS_NOP, NULL, 0);
+    CHECK(2 == trace.stats.empty_writes);
+    CHECK(1 == trace.stats.partial_bytes);
+    CHECK(BLUE == gram[3 * WIDTH + 2]);
+
+    /* Window outside of the image. */
+    window(&trace, WIDTH, 0, WIDTH, 0);
+    fill(&trace, BLUE, 1);
+    CHECK(1 == trace.stats.pixels_clipped);
+}
+
+static void
+test_scroll(void)
+{
+    static uint16_t gram[WIDTH * HEIGHT];
+    static uint16_t screen[WIDTH * HEIGHT];
+    mipi_display_trace_t trace;
+
+    mipi_display_trace_init(&trace, gram, WIDTH, HEIGHT);
+    init(&trace);
+
+    /* Each line has its number as color. */
+    window(&trace, 0, 0, WIDTH - 1, HEIGHT - 1);
+    command(&trace, MIPI_DCS_WRITE_MEMORY_START, NULL, 0);
+    for (uint8_t y = 0; y < HEIGHT; y++) {
+        mipi_display_trace_feed(&trace, 1, (uint8_t[]) {0, y}, 2, WIDTH);
+    }
+
+    /* Without scroll start screen is the same as GRAM. */
+    mipi_display_trace_screen(&trace, screen);
+    CHECK(0 == memcmp(gram, screen, sizeof(gram)));
+
+    /* Fixed top line, three line scroll area starting from line 2. */
+    command(&trace, MIPI_DCS_SET_SCROLL_AREA, (uint8_t[]) {0, 1, 0, 3, 0, 0}, 6);
+    command(&trace, MIPI_DCS_SET_SCROLL_START, (uint8_t[]) {0, 2}, 2);
+    mipi_display_trace_screen(&trace, screen);
+
+    CHECK(0 == screen[0 * WIDTH]);
+    CHECK(2 == screen[1 * WIDTH]);
+    CHECK(3 == screen[2 * WIDTH + WIDTH - 1]);
+    CHECK(1 == screen[3 * WIDTH]);
+
+    /* GRAM itself does not move. */
+    for (uint8_t y = 0; y < HEIGHT; y++) {
+        CHECK(y == gram[y * WIDTH]);
+    }
+
+    command(&trace, MIPI_DCS_SET_SCROLL_START, (uint8_t[]) {0, 2}, 2);
+    CHECK(1 == trace.stats.redundant_commands);
+}
+
+int
+main(void)
+{
+    test_fill();
+    test_scroll();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -39,10 +39,59 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <hardware/spi.h>
+#include <hardware/dma.h>
+#ifdef HAGL_HAL_USE_PIO
+#include <hardware/pio.h>
+#endif /* HAGL_HAL_USE_PIO */
 
 #include <hagl/backend.h>
 
+#if defined(HAGL_HAL_USE_SHARED_BUS) && !defined(HAGL_HAL_USE_DMA)
+#error "HAGL_HAL_USE_SHARED_BUS requires HAGL_HAL_USE_DMA"
+#endif
+
+#if defined(HAGL_HAL_USE_SHARED_BUS) && defined(HAGL_HAL_USE_MULTICORE)
+#error "HAGL_HAL_USE_SHARED_BUS cannot be used with HAGL_HAL_USE_MULTICORE"
+#endif
+
+#if defined(HAGL_HAL_USE_FENCE) && !defined(HAGL_HAL_USE_DMA)
+#error "HAGL_HAL_USE_FENCE requires HAGL_HAL_USE_DMA"
+#endif
+
+#if defined(HAGL_HAL_USE_FENCE) && defined(HAGL_HAL_USE_MULTICORE)
+#error "HAGL_HAL_USE_FENCE cannot be used with HAGL_HAL_USE_MULTICORE"
+#endif
+
+#if defined(HAGL_HAL_USE_RUNTIME_BUFFER) && (defined(HAGL_HAL_USE_SINGLE_BUFFER) || defined(HAGL_HAL_USE_DOUBLE_BUFFER) || defined(HAGL_HAL_USE_TRIPLE_BUFFER) || defined(HAGL_HAL_USE_BAND_BUFFER))
+#error "HAGL_HAL_USE_RUNTIME_BUFFER selects the buffering per display, do not set it at compile time"
+#endif
+
+#if defined(HAGL_HAL_USE_RUNTIME_BUFFER) && (defined(HAGL_HAL_USE_SCROLL) || defined(HAGL_HAL_USE_LOW_POWER) || defined(HAGL_HAL_USE_INDEXED_COLOR) || defined(HAGL_HAL_USE_FENCE))
+#error "HAGL_HAL_USE_RUNTIME_BUFFER cannot be used with scrolling, low power, indexed color or fences"
+#endif
+
+#if defined(HAGL_HAL_USE_TE_FLUSH) && !defined(HAGL_HAL_USE_DMA)
+#error "HAGL_HAL_USE_TE_FLUSH requires HAGL_HAL_USE_DMA"
+#endif
+
+#if defined(HAGL_HAL_USE_TE_FLUSH) && (defined(HAGL_HAL_USE_ROW_HASH) || defined(HAGL_HAL_USE_INDEXED_COLOR) || defined(HAGL_HAL_USE_RGB444) || (defined(HAGL_HAL_PIXEL_SIZE) && HAGL_HAL_PIXEL_SIZE > 1))
+#error "HAGL_HAL_USE_TE_FLUSH cannot be used with row hashing, indexed color, RGB444 or pixel size above one"
+#endif
+
+#if defined(HAGL_HAL_USE_BEAM_RACE) && defined(HAGL_HAL_USE_DIRTY_RECTS)
+#error "HAGL_HAL_USE_BEAM_RACE cannot be used with HAGL_HAL_USE_DIRTY_RECTS"
+#endif
+
+#if defined(HAGL_HAL_USE_SCROLL) && defined(HAGL_HAL_PIXEL_SIZE) && HAGL_HAL_PIXEL_SIZE > 1
+#error "HAGL_HAL_USE_SCROLL requires HAGL_HAL_PIXEL_SIZE of one"
+#endif
+
+#if defined(HAGL_HAL_USE_SCROLL) && defined(HAGL_HAL_USE_INDEXED_COLOR)
+#error "HAGL_HAL_USE_SCROLL cannot be used with HAGL_HAL_USE_INDEXED_COLOR"
+#endif
+
 #include "hagl_hal_color.h"
 
 #define hagl_hal_debug(fmt, ...) \
@@ -70,11 +119,223 @@ extern "C" {
 #define HAGL_HAS_HAL_BACK_BUFFER
 #endif
 
+#ifdef HAGL_HAL_USE_BAND_BUFFER
+#define HAGL_HAS_HAL_BACK_BUFFER
+#endif
+
 #ifdef HAGL_HAL_USE_SINGLE_BUFFER
 #undef HAGL_HAS_HAL_BACK_BUFFER
 #endif
 
+#ifdef HAGL_HAL_USE_RUNTIME_BUFFER
+#define HAGL_HAS_HAL_BACK_BUFFER
+#endif
+
+/* Values for the buffering field of the display config. */
+#define MIPI_DISPLAY_BUFFERING_DEFAULT  (0)
+#define MIPI_DISPLAY_BUFFERING_SINGLE   (1)
+#define MIPI_DISPLAY_BUFFERING_DOUBLE   (2)
+#define MIPI_DISPLAY_BUFFERING_TRIPLE   (3)
+
+/* Buffering used when the display config does not set one. */
+#ifndef HAGL_HAL_BUFFERING
+#define HAGL_HAL_BUFFERING          MIPI_DISPLAY_BUFFERING_DOUBLE
+#endif
+
+/* Capacity of the deferred display list used when single buffering. */
+#ifndef HAGL_HAL_DISPLAY_LIST_SIZE
+#define HAGL_HAL_DISPLAY_LIST_SIZE      (64)
+#endif
+
+#ifndef HAGL_HAL_DISPLAY_LIST_PIXELS
+#define HAGL_HAL_DISPLAY_LIST_PIXELS    (256)
+#endif
+
+/* Height of the band buffers and capacity of the recorded frame. */
+#ifndef HAGL_HAL_BAND_HEIGHT
+#define HAGL_HAL_BAND_HEIGHT        (20)
+#endif
+
+#ifndef HAGL_HAL_BAND_OPS
+#define HAGL_HAL_BAND_OPS           (256)
+#endif
+
+#ifndef HAGL_HAL_BAND_PIXELS
+#define HAGL_HAL_BAND_PIXELS        (4096)
+#endif
+
+/* Bits per pixel of the indexed color back buffer, 4 or 8. */
+#ifndef HAGL_HAL_INDEXED_DEPTH
+#define HAGL_HAL_INDEXED_DEPTH      (8)
+#endif
+
+/* Pixels packed at a time when sending 12 bit pixels, multiple of 8. */
+#ifndef HAGL_HAL_RGB444_CHUNK
+#define HAGL_HAL_RGB444_CHUNK       (128)
+#endif
+
+/* Alignment of back buffers allocated from an arena, power of two. */
+#ifndef HAGL_HAL_BUFFER_ALIGN
+#define HAGL_HAL_BUFFER_ALIGN       (4)
+#endif
+
+/* Allocations an arena keeps track of so that they can be freed. */
+#ifndef HAGL_HAL_ARENA_DEPTH
+#define HAGL_HAL_ARENA_DEPTH        (8)
+#endif
+
+/* Values for the transport field of the display config. */
+#define MIPI_DISPLAY_TRANSPORT_SPI  (0)
+#define MIPI_DISPLAY_TRANSPORT_PIO  (1)
+
+/* Power modes, idle mode reduces colors to eight. */
+#define MIPI_DISPLAY_POWER_NORMAL   (0)
+#define MIPI_DISPLAY_POWER_PARTIAL  (1)
+#define MIPI_DISPLAY_POWER_IDLE     (2)
+#define MIPI_DISPLAY_POWER_MODES    (3)
+
+/* Maximum number of damaged rectangles tracked between flushes. */
+#ifndef HAGL_HAL_DIRTY_RECTS
+#define HAGL_HAL_DIRTY_RECTS        (8)
+#endif
+
+/* Scanlines kept between the scanout and the write when beam racing. */
+#ifndef HAGL_HAL_BEAM_MARGIN
+#define HAGL_HAL_BEAM_MARGIN        (8)
+#endif
+
+/*
+ * Datasheet minimum delays in milliseconds. ST7735S, ST7789, ILI9341 and
+ * ILI9163 all share these. Reset takes 5 ms when the panel is sleeping
+ * but 120 ms when it is awake. Commands can be sent 5 ms after sleep out
+ * but the panel settles in 120 ms.
+ */
+#ifndef MIPI_DISPLAY_RESET_DELAY_MS
+#define MIPI_DISPLAY_RESET_DELAY_MS         (5)
+#endif
+
+#ifndef MIPI_DISPLAY_RESET_AWAKE_DELAY_MS
+#define MIPI_DISPLAY_RESET_AWAKE_DELAY_MS   (120)
+#endif
+
+/*
+ * Without MISO the power mode cannot be read and the panel is assumed to
+ * be sleeping. Set to 1 to use the awake reset delay for boards which
+ * reboot with the panel powered.
+ */
+#ifndef MIPI_DISPLAY_ASSUME_AWAKE
+#define MIPI_DISPLAY_ASSUME_AWAKE           (0)
+#endif
+
+#ifndef MIPI_DISPLAY_COMMAND_DELAY_MS
+#define MIPI_DISPLAY_COMMAND_DELAY_MS       (5)
+#endif
+
+#ifndef MIPI_DISPLAY_SLEEP_OUT_DELAY_MS
+#define MIPI_DISPLAY_SLEEP_OUT_DELAY_MS     (120)
+#endif
+
+/* Panels cannot be read at full write speed. */
+#ifndef MIPI_DISPLAY_SPI_READ_SPEED_HZ
+#define MIPI_DISPLAY_SPI_READ_SPEED_HZ      (6000000)
+#endif
+
+/* Modelled cost of toggling CS and DC around each command in nanoseconds. */
+#ifndef MIPI_DISPLAY_MODEL_COMMAND_NS
+#define MIPI_DISPLAY_MODEL_COMMAND_NS   (100)
+#endif
+
+#define MIPI_DISPLAY_COUNTERS_CSV   (0)
+#define MIPI_DISPLAY_COUNTERS_JSON  (1)
+
+/* Number of window writes which can wait for a shared SPI bus. */
+#ifndef MIPI_DISPLAY_BUS_QUEUE
+#define MIPI_DISPLAY_BUS_QUEUE      (8)
+#endif
+
+/* Number of scanlines hashed together when looking for changed rows. */
+#ifndef HAGL_HAL_ROW_HASH_BAND
+#define HAGL_HAL_ROW_HASH_BAND      (8)
+#endif
+
+/*
+ * Deferred write to an address window. Solid windows are filled with a
+ * single color, others have their pixels in the pixel pool.
+ */
+typedef struct {
+    uint16_t    x0, y0;
+    uint16_t    w, h;
+    hagl_color_t color;
+    uint16_t    offset;
+    bool        solid;
+} hagl_hal_command_t;
+
+/*
+ * Drawing operation recorded for band rendering. Bitmaps are copied to
+ * the pixel pool since HAGL passes temporary bitmaps for example when
+ * drawing text.
+ */
+typedef struct {
+    uint8_t     type;
+    int16_t     x0, y0;
+    uint16_t    w, h;
+    uint16_t    src_w, src_h;
+    hagl_color_t color;
+    uint32_t    offset;
+} hagl_hal_op_t;
+
+typedef size_t (*mipi_display_job_t)(const void *arg);
+
+/* Caller supplied memory which back buffers are allocated from. */
 typedef struct {
+    uint8_t     *base;
+    size_t      size;
+    size_t      used;
+    /* Start of each allocation, most recent last. */
+    size_t      start[HAGL_HAL_ARENA_DEPTH];
+    uint8_t     count;
+} hagl_hal_arena_t;
+
+/* Times are in microseconds. */
+typedef struct {
+    uint64_t    pixel_bytes;
+    uint64_t    command_bytes;
+    uint32_t    commands;
+    uint32_t    window_changes;
+    uint32_t    window_hits;
+    uint32_t    frames;
+    uint64_t    flush_time;
+    uint64_t    te_wait_time;
+    uint64_t    dma_stall_time;
+} mipi_display_counters_t;
+
+struct mipi_display_config;
+
+typedef uint32_t mipi_display_fence_t;
+typedef void (*mipi_display_trace_callback_t)(uint8_t dc, const uint8_t *data, size_t length, size_t repeat, void *arg);
+typedef void (*mipi_display_fence_callback_t)(struct mipi_display_config *display_config, mipi_display_fence_t fence, void *arg);
+
+/* Window write waiting for the shared bus. */
+typedef struct {
+    struct mipi_display_config *display_config;
+    uint16_t    x1, y1, w, h;
+    const uint8_t *buffer;
+} mipi_display_bus_request_t;
+
+/*
+ * SPI port shared by several displays with their own CS pins. Owner is the
+ * display which last used the bus and whose CS might still be low.
+ */
+typedef struct {
+    spi_inst_t  *spi;
+    struct mipi_display_config *volatile owner;
+    mipi_display_bus_request_t queue[MIPI_DISPLAY_BUS_QUEUE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile bool dispatching;
+} mipi_display_bus_t;
+
+typedef struct mipi_display_config {
     uint32_t    spi_freq;
     spi_inst_t  *spi;
     int16_t     pin_cs;
@@ -95,6 +356,124 @@ typedef struct {
     hagl_window_t prev_clip;
     hagl_bitmap_t *bb;
     void *(*haglCalloc)(size_t, size_t);
+    uint8_t     transport;
+    volatile uint32_t vblank_count;
+    volatile uint64_t vblank_time;
+    volatile uint32_t vblank_period;
+    volatile mipi_display_job_t vblank_job;
+    const void  *vblank_arg;
+    volatile size_t vblank_sent;
+    volatile bool vblank_running;
+#ifdef HAGL_HAL_USE_PIO
+    PIO         pio;
+    uint8_t     pio_sm;
+    int         pio_dma_control;
+    int         pio_dma_data;
+    dma_channel_config pio_dma_config;
+    uint32_t    pio_fill_word;
+    uint32_t    pio_stream[11];
+#endif /* HAGL_HAL_USE_PIO */
+#if defined(HAGL_HAL_USE_SINGLE_BUFFER) || defined(HAGL_HAL_USE_RUNTIME_BUFFER) || defined(HAGL_HAL_USE_INDEXED_COLOR) || HAGL_HAL_PIXEL_SIZE > 1
+    hagl_color_t *line_buffer[2];
+#endif /* HAGL_HAL_USE_SINGLE_BUFFER || HAGL_HAL_USE_RUNTIME_BUFFER || HAGL_HAL_USE_INDEXED_COLOR || HAGL_HAL_PIXEL_SIZE > 1 */
+#ifdef HAGL_HAL_USE_RUNTIME_BUFFER
+    uint8_t     buffering;
+    uint8_t     *allocated[2];
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
+#ifdef HAGL_HAL_USE_ARENA
+    hagl_hal_arena_t *arena[2];
+#endif /* HAGL_HAL_USE_ARENA */
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+    hagl_color_t palette[1 << HAGL_HAL_INDEXED_DEPTH];
+#if HAGL_HAL_INDEXED_DEPTH == 4
+    uint32_t    palette_pair[256];
+#endif /* HAGL_HAL_INDEXED_DEPTH == 4 */
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+#ifdef HAGL_HAL_USE_DISPLAY_LIST
+    hagl_hal_command_t list[HAGL_HAL_DISPLAY_LIST_SIZE];
+    hagl_color_t list_pixels[HAGL_HAL_DISPLAY_LIST_PIXELS];
+    uint16_t    list_count;
+    uint16_t    list_pixel_count;
+#endif /* HAGL_HAL_USE_DISPLAY_LIST */
+#ifdef HAGL_HAL_USE_BAND_BUFFER
+    hagl_hal_op_t ops[HAGL_HAL_BAND_OPS];
+    hagl_color_t op_pixels[HAGL_HAL_BAND_PIXELS];
+    uint16_t    op_count;
+    uint32_t    op_pixel_count;
+    hagl_bitmap_t band[2];
+#endif /* HAGL_HAL_USE_BAND_BUFFER */
+#ifdef HAGL_HAL_USE_BEAM_RACE
+    uint32_t    beam_row_time;
+#endif /* HAGL_HAL_USE_BEAM_RACE */
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    hagl_window_t dirty[HAGL_HAL_DIRTY_RECTS];
+    uint8_t     dirty_count;
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+#ifdef HAGL_HAL_USE_ROW_HASH
+    uint32_t    *row_hash;
+    uint8_t     *row_changed;
+    uint16_t    row_hash_count;
+    bool        row_hash_valid;
+    int         row_hash_dma_channel;
+#endif /* HAGL_HAL_USE_ROW_HASH */
+#ifdef HAGL_HAL_USE_LOW_POWER
+    uint8_t     power_mode;
+    bool        drawn;
+    uint64_t    power_since;
+    uint64_t    power_time[MIPI_DISPLAY_POWER_MODES];
+#endif /* HAGL_HAL_USE_LOW_POWER */
+#ifdef HAGL_HAL_USE_SCROLL
+    uint16_t    gram_height;
+    uint16_t    scroll_top;
+    uint16_t    scroll_bottom;
+    uint16_t    scroll_offset;
+    /* Rows of the current stream which go past the wrap in GRAM. */
+    uint16_t    stream_x;
+    uint16_t    stream_y;
+    uint16_t    stream_w;
+    uint16_t    stream_h;
+    size_t      stream_left;
+#endif /* HAGL_HAL_USE_SCROLL */
+#ifdef HAGL_HAL_USE_RGB444
+    uint32_t    rgb444_buffer[2][HAGL_HAL_RGB444_CHUNK * 3 / 8];
+    uint8_t     rgb444_current;
+    uint16_t    rgb444_carry;
+    bool        rgb444_pending;
+#endif /* HAGL_HAL_USE_RGB444 */
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    mipi_display_bus_t *bus;
+    volatile uint8_t bus_pending;
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+#ifdef HAGL_HAL_USE_DMA
+    int         dma_channel;
+    dma_channel_config dma_config;
+    uint16_t    dma_fill_color;
+    uint8_t     dma_data_bits;
+    bool        dma_fill;
+#endif /* HAGL_HAL_USE_DMA */
+#ifdef HAGL_HAL_USE_FENCE
+    volatile uint32_t fence_started;
+    volatile uint32_t fence_done;
+    mipi_display_fence_t fence_notify;
+    volatile mipi_display_fence_callback_t fence_callback;
+    void        *fence_arg;
+#endif /* HAGL_HAL_USE_FENCE */
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_counters_t counters;
+    bool        counters_pixels;
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace_callback_t trace_callback;
+    void        *trace_arg;
+#endif /* HAGL_HAL_USE_TRACE */
+#ifdef HAGL_HAL_USE_MULTICORE
+    volatile bool   busy;
+    volatile size_t sent;
+#ifdef HAGL_HAL_USE_DIRTY_RECTS
+    hagl_window_t dirty_flush[HAGL_HAL_DIRTY_RECTS];
+    uint8_t     dirty_flush_count;
+#endif /* HAGL_HAL_USE_DIRTY_RECTS */
+#endif /* HAGL_HAL_USE_MULTICORE */
 } mipi_display_config_t;
 
 #define GET_MIPI_DISPLAY_CONFIG(self)         (mipi_display_config_t *)((hagl_backend_t *)self)->display_config
@@ -105,6 +484,123 @@ typedef struct {
  */
 void hagl_hal_init(hagl_backend_t *backend);
 
+#ifdef HAGL_HAL_USE_ARENA
+/**
+ * Initialize an arena in caller supplied memory
+ *
+ * Set the arena field of the display config to it before initialising
+ * the display. Back buffers and line buffers are then allocated from
+ * the arena. With a second arena the second triple buffer comes from it.
+ */
+void hagl_hal_arena_init(hagl_hal_arena_t *arena, void *base, size_t size);
+
+/* Allocate zeroed memory, NULL if it does not fit. */
+void *hagl_hal_arena_alloc(hagl_hal_arena_t *arena, size_t size, size_t align);
+
+/*
+ * Release the buffer if it is the most recent allocation. Other buffers
+ * stay allocated until everything allocated after them has been released.
+ */
+void hagl_hal_arena_free(hagl_hal_arena_t *arena, void *buffer);
+
+/* True if the buffer is inside the arena. */
+bool hagl_hal_arena_owns(const hagl_hal_arena_t *arena, const void *buffer);
+#endif /* HAGL_HAL_USE_ARENA */
+
+/*
+ * Allocate back buffer or line buffers, from the arena when there is one.
+ * With runtime buffering the heap is always used instead of the fallback.
+ */
+void *hagl_hal_buffer_calloc(mipi_display_config_t *display_config, uint8_t index, size_t size, void *(*fallback)(size_t, size_t));
+void hagl_hal_buffer_free(mipi_display_config_t *display_config, void *buffer);
+
+#ifdef HAGL_HAL_USE_RUNTIME_BUFFER
+/**
+ * Switch the buffering of an initialised display
+ *
+ * Waits for transfers from the current buffers to finish. Back buffers
+ * allocated by the HAL which the new buffering does not need are freed,
+ * buffers provided by the caller are kept. Contents of the back buffers
+ * are not preserved, the next frame should be drawn from scratch.
+ */
+void hagl_hal_set_buffering(hagl_backend_t *backend, uint8_t buffering);
+
+/* Set up the buffers and backend functions, display is already initialised. */
+void hagl_hal_single_init(hagl_backend_t *backend);
+void hagl_hal_double_init(hagl_backend_t *backend);
+void hagl_hal_triple_init(hagl_backend_t *backend);
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
+
+#ifdef HAGL_HAL_USE_DOUBLE_BUFFER
+/**
+ * Flush given area of the back buffer immediately
+ *
+ * Does not wait for vsync and does not affect the dirty rectangles
+ * which will be sent by the next flush.
+ */
+size_t hagl_hal_flush_rect(hagl_backend_t *backend, int16_t x0, int16_t y0, uint16_t w, uint16_t h);
+#endif /* HAGL_HAL_USE_DOUBLE_BUFFER */
+
+#if defined(HAGL_HAL_USE_FENCE) && (defined(HAGL_HAL_USE_DOUBLE_BUFFER) || defined(HAGL_HAL_USE_TRIPLE_BUFFER))
+/**
+ * Flush the back buffer without waiting for the transfer
+ *
+ * Returned fence is signalled when the flushed buffer can be drawn to
+ * again. Wait for it with mipi_display_fence_wait().
+ */
+mipi_display_fence_t hagl_hal_flush_async(hagl_backend_t *backend);
+#endif /* HAGL_HAL_USE_FENCE && (HAGL_HAL_USE_DOUBLE_BUFFER || HAGL_HAL_USE_TRIPLE_BUFFER) */
+
+#ifdef HAGL_HAL_USE_SCROLL
+/**
+ * Set the fixed areas at the top and bottom of the display
+ *
+ * Rows between them form the vertical scrolling area. Resets the scroll
+ * offset. Coordinates used for drawing stay the same when scrolling.
+ */
+void hagl_hal_scroll_area(hagl_backend_t *backend, uint16_t top, uint16_t bottom);
+
+/**
+ * Scroll the scrolling area up by given number of lines, down if negative
+ *
+ * Only the scroll start address is sent. Rows exposed at the bottom, or
+ * at the top when scrolling down, should be redrawn. With double buffering
+ * the back buffer is scrolled too and the exposed rows are sent with the
+ * next flush.
+ */
+void hagl_hal_scroll(hagl_backend_t *backend, int16_t lines);
+#endif /* HAGL_HAL_USE_SCROLL */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+/**
+ * Put the display to partial or idle mode
+ *
+ * Only the rows of the given area are refreshed by the panel, rest of
+ * the display is blank. Idle mode also reduces colors to eight. Display
+ * returns to normal mode automatically when anything is sent to it. NULL
+ * area means the whole display.
+ */
+void hagl_hal_power_mode(hagl_backend_t *backend, uint8_t mode, const hagl_window_t *area);
+
+/**
+ * Get the time in microseconds spent in each power mode
+ *
+ * Array must have room for MIPI_DISPLAY_POWER_MODES values.
+ */
+void hagl_hal_power_time(hagl_backend_t *backend, uint64_t *time);
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+/**
+ * Set the palette used by the indexed color back buffer
+ *
+ * Colors are in the same format as returned by hagl_color(). The whole
+ * back buffer is sent on the next flush so changing the palette can be
+ * used for palette cycling effects.
+ */
+void hagl_hal_set_palette(hagl_backend_t *backend, const hagl_color_t *palette, uint16_t count);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
 #ifdef __cplusplus
 }
 #endif
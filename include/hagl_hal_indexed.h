@@ -0,0 +1,62 @@
+/*
+
+MIT License
+
+Copyright (c) 2019-2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+*/
+
+#ifndef _HAGL_HAL_INDEXED_H
+#define _HAGL_HAL_INDEXED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <hagl/bitmap.h>
+
+#include "hagl_hal.h"
+
+#ifdef HAGL_HAL_USE_INDEXED_COLOR
+/* Initialize bitmap which stores palette indices instead of colors. */
+void hagl_hal_indexed_init(hagl_bitmap_t *bitmap, int16_t width, int16_t height, uint8_t *buffer);
+/* Bytes needed for an indexed bitmap of given size. */
+size_t hagl_hal_indexed_size(int16_t width, int16_t height);
+/* Store the palette and build the lookup tables. */
+void hagl_hal_indexed_palette(mipi_display_config_t *display_config, const hagl_color_t *palette, uint16_t count);
+/* Send an area of an indexed bitmap expanding indices to colors. */
+size_t hagl_hal_indexed_write(mipi_display_config_t *display_config, uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, const uint8_t *buffer, size_t pitch);
+#endif /* HAGL_HAL_USE_INDEXED_COLOR */
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _HAGL_HAL_INDEXED_H */
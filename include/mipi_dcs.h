@@ -114,6 +114,13 @@ extern "C" {
 #define MIPI_DCS_SET_TEAR_ON_VSYNC          0x00
 #define MIPI_DCS_SET_TEAR_ON_VSYNC_HSYNC    0x01
 
+#define MIPI_DCS_POWER_MODE_BOOSTER_ON      0x80
+#define MIPI_DCS_POWER_MODE_IDLE_ON         0x40
+#define MIPI_DCS_POWER_MODE_PARTIAL_ON      0x20
+#define MIPI_DCS_POWER_MODE_SLEEP_OUT       0x10
+#define MIPI_DCS_POWER_MODE_NORMAL_ON       0x08
+#define MIPI_DCS_POWER_MODE_DISPLAY_ON      0x04
+
 #ifdef __cplusplus
 }
 #endif
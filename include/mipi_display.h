@@ -45,11 +45,79 @@ extern "C" {
 
 void mipi_display_init(mipi_display_config_t *display_config);
 size_t mipi_display_write_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *buffer);
+size_t mipi_display_write_xywh_pitch(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch);
+#if HAGL_HAL_PIXEL_SIZE > 1
+size_t mipi_display_write_xywh_scaled(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch, uint8_t scale);
+#endif /* HAGL_HAL_PIXEL_SIZE > 1 */
+void mipi_display_start_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h);
+size_t mipi_display_write_stream(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length);
+void mipi_display_sync(mipi_display_config_t *display_config);
+/* True while a transfer to the display is still running. */
+bool mipi_display_busy(mipi_display_config_t *display_config);
+#ifdef HAGL_HAL_USE_SCROLL
+void mipi_display_scroll_area(mipi_display_config_t *display_config, uint16_t top, uint16_t bottom);
+void mipi_display_scroll(mipi_display_config_t *display_config, int16_t lines);
+#endif /* HAGL_HAL_USE_SCROLL */
+#ifdef HAGL_HAL_USE_LOW_POWER
+void mipi_display_power_mode(mipi_display_config_t *display_config, uint8_t mode, const hagl_window_t *area);
+void mipi_display_power_time(mipi_display_config_t *display_config, uint64_t *time);
+#endif /* HAGL_HAL_USE_LOW_POWER */
 size_t mipi_display_write_xy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint8_t *buffer);
 size_t mipi_display_fill_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, void *color);
 void mipi_display_ioctl(mipi_display_config_t *display_config, uint8_t command, uint8_t *data, size_t size);
 void mipi_display_close(mipi_display_config_t *display_config);
 
+/* Wait for the next rising edge of the TE signal. */
+void mipi_display_vblank_wait(mipi_display_config_t *display_config);
+/* Number of vblanks since init and optionally the time of the latest one. */
+uint32_t mipi_display_vblank(mipi_display_config_t *display_config, uint64_t *time);
+/* Microseconds since the latest vblank, modulo the measured refresh period. */
+uint32_t mipi_display_vblank_phase(mipi_display_config_t *display_config);
+/* Wait until the given number of microseconds has passed since a vblank. */
+void mipi_display_vblank_wait_phase(mipi_display_config_t *display_config, uint32_t phase);
+/* Run the job from the TE interrupt at the next vblank. */
+void mipi_display_vblank_submit(mipi_display_config_t *display_config, mipi_display_job_t job, const void *arg);
+/* Wait for the job submitted for vblank and its transfer to finish, returns the bytes it sent. */
+size_t mipi_display_vblank_sync(mipi_display_config_t *display_config);
+
+#ifdef HAGL_HAL_USE_COUNTERS
+/* Copy the counters of the display. */
+void mipi_display_counters(mipi_display_config_t *display_config, mipi_display_counters_t *counters);
+void mipi_display_counters_reset(mipi_display_config_t *display_config);
+/* Add a flushed frame which was started at the given time_us_64(). */
+void mipi_display_count_flush(mipi_display_config_t *display_config, uint64_t start);
+/* Time the counted bytes take on the bus in microseconds with the current clock. */
+uint64_t mipi_display_counters_wire_time(mipi_display_config_t *display_config, const mipi_display_counters_t *counters);
+/* Print the counters as one CSV row or JSON object. With NULL name or counters only the CSV header is printed. */
+void mipi_display_counters_print(mipi_display_config_t *display_config, const mipi_display_counters_t *counters, const char *name, uint8_t format);
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+#ifdef HAGL_HAL_USE_FENCE
+/* Fence which is signalled when all transfers started so far have finished. */
+mipi_display_fence_t mipi_display_fence(mipi_display_config_t *display_config);
+bool mipi_display_fence_poll(mipi_display_config_t *display_config, mipi_display_fence_t fence);
+void mipi_display_fence_wait(mipi_display_config_t *display_config, mipi_display_fence_t fence);
+/* Call the callback once the fence is signalled, usually from the DMA interrupt. */
+void mipi_display_fence_notify(mipi_display_config_t *display_config, mipi_display_fence_t fence, mipi_display_fence_callback_t callback, void *arg);
+#endif /* HAGL_HAL_USE_FENCE */
+
+#ifdef HAGL_HAL_USE_SHARED_BUS
+void mipi_display_bus_init(mipi_display_bus_t *bus, spi_inst_t *spi);
+/* Write a window, queued if another display is using the bus. Buffer must stay valid until mipi_display_sync(). */
+size_t mipi_display_bus_write_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer);
+/* Wait for the queued and running writes of this display only. */
+void mipi_display_bus_sync(mipi_display_config_t *display_config);
+/* Start queued writes if the bus is free. Call this while rendering to keep the bus busy. */
+void mipi_display_bus_poll(mipi_display_bus_t *bus);
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+#ifdef HAGL_HAL_USE_MULTICORE
+/* Run the job on core 1 after previously submitted job has finished. */
+void mipi_display_submit(mipi_display_config_t *display_config, mipi_display_job_t job, const void *arg);
+/* Wait for the submitted job to finish, returns the bytes it sent. */
+size_t mipi_display_wait(mipi_display_config_t *display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
 #ifdef __cplusplus
 }
 #endif
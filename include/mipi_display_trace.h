@@ -0,0 +1,123 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Decoder for the command and data stream sent to the display. It keeps
+the same state as the display controller, address window, address mode,
+pixel format and scroll area, and optionally an image of the GRAM. Bytes
+which did not change anything on the display are counted as wasted.
+
+Depends only on the C library so it can also be compiled on a host and
+fed with a stream captured on the device.
+
+*/
+
+#ifndef _MIPI_DISPLAY_TRACE_H
+#define _MIPI_DISPLAY_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MIPI_DISPLAY_TRACE_KNOWN_COLUMN         (1 << 0)
+#define MIPI_DISPLAY_TRACE_KNOWN_PAGE           (1 << 1)
+#define MIPI_DISPLAY_TRACE_KNOWN_ADDRESS_MODE   (1 << 2)
+#define MIPI_DISPLAY_TRACE_KNOWN_PIXEL_FORMAT   (1 << 3)
+#define MIPI_DISPLAY_TRACE_KNOWN_SCROLL_AREA    (1 << 4)
+#define MIPI_DISPLAY_TRACE_KNOWN_SCROLL_START   (1 << 5)
+
+typedef struct {
+    uint32_t    commands;
+    uint64_t    command_bytes;
+    uint64_t    pixel_bytes;
+    uint64_t    pixels;
+    /* Pixels outside of the GRAM image. */
+    uint64_t    pixels_clipped;
+    /* Command which set a value the display already had. */
+    uint32_t    redundant_commands;
+    uint64_t    redundant_bytes;
+    /* Address set again before any pixels were written to it. */
+    uint32_t    overwritten_commands;
+    uint64_t    overwritten_bytes;
+    /* Memory write without any pixels or with a partial last pixel. */
+    uint32_t    empty_writes;
+    uint64_t    partial_bytes;
+} mipi_display_trace_stats_t;
+
+typedef struct {
+    /* Optional image of the GRAM, pixels as RGB565 regardless of format. */
+    uint16_t    *gram;
+    uint16_t    gram_width;
+    uint16_t    gram_height;
+
+    uint8_t     command;
+    uint8_t     params[8];
+    uint16_t    param_count;
+
+    uint16_t    x0, x1, y0, y1;
+    uint16_t    x, y;
+    uint8_t     address_mode;
+    uint8_t     pixel_format;
+    uint16_t    scroll_top, scroll_height, scroll_bottom;
+    uint16_t    scroll_start;
+
+    /* Which of the above have been set, see MIPI_DISPLAY_TRACE_KNOWN_*. */
+    uint8_t     known;
+    /* Address commands not yet followed by a memory write. */
+    uint8_t     pending;
+    bool        writing;
+    uint64_t    written;
+    uint8_t     pixel[3];
+    uint8_t     pixel_count;
+
+    mipi_display_trace_stats_t stats;
+} mipi_display_trace_t;
+
+/* Initialize decoder. GRAM image can be NULL. */
+void mipi_display_trace_init(mipi_display_trace_t *trace, uint16_t *gram, uint16_t width, uint16_t height);
+/* Feed bytes which were sent with given DC level, repeat times in a row. */
+void mipi_display_trace_feed(mipi_display_trace_t *trace, uint8_t dc, const uint8_t *data, size_t length, size_t repeat);
+/* Same as above with the decoder as the last argument, usable as a trace hook. */
+void mipi_display_trace_hook(uint8_t dc, const uint8_t *data, size_t length, size_t repeat, void *trace);
+/* Clear the stats, for example after each frame. */
+void mipi_display_trace_reset(mipi_display_trace_t *trace);
+/* Copy GRAM image to screen in the order lines are shown with the scroll start applied. */
+void mipi_display_trace_screen(const mipi_display_trace_t *trace, uint16_t *screen);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _MIPI_DISPLAY_TRACE_H */
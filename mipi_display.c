@@ -33,30 +33,555 @@ SPDX-License-Identifier: MIT
 
 #include <stdio.h>
 #include <stdlib.h>
-// #include <string.h>
+#include <string.h>
 // #include <stdatomic.h>
 
 #include <hardware/spi.h>
 #include <hardware/dma.h>
 #include <hardware/gpio.h>
 #include <hardware/clocks.h>
+#include <hardware/sync.h>
+#include <hardware/irq.h>
 #include <pico/time.h>
+#ifdef HAGL_HAL_USE_MULTICORE
+#include <pico/multicore.h>
+#endif /* HAGL_HAL_USE_MULTICORE */
 
 #include "mipi_dcs.h"
 #include "mipi_display.h"
+#ifdef HAGL_HAL_USE_PIO
+#include "mipi_display.pio.h"
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifdef HAGL_HAL_USE_COUNTERS
+/* Data following a memory write is pixels, any other data is parameters. */
+static inline void
+mipi_display_count_command(mipi_display_config_t *display_config, uint8_t command)
+{
+    display_config->counters.command_bytes++;
+    display_config->counters.commands++;
+    display_config->counters_pixels =
+        MIPI_DCS_WRITE_MEMORY_START == command || MIPI_DCS_WRITE_MEMORY_CONTINUE == command;
+}
+
+static inline void
+mipi_display_count_data(mipi_display_config_t *display_config, size_t length)
+{
+    if (display_config->counters_pixels) {
+        display_config->counters.pixel_bytes += length;
+    } else {
+        display_config->counters.command_bytes += length;
+    }
+}
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+#ifdef HAGL_HAL_USE_TRACE
+/* Bytes as they appear on the wire, repeated for fills. */
+static inline void
+mipi_display_trace(mipi_display_config_t *display_config, uint8_t dc, const uint8_t *data, size_t length, size_t repeat)
+{
+    if (display_config->trace_callback) {
+        display_config->trace_callback(dc, data, length, repeat, display_config->trace_arg);
+    }
+}
+#endif /* HAGL_HAL_USE_TRACE */
 
-static int dma_channel;
+static inline bool
+mipi_display_is_single_buffered(const mipi_display_config_t *display_config)
+{
+#if defined(HAGL_HAL_USE_RUNTIME_BUFFER)
+    return MIPI_DISPLAY_BUFFERING_SINGLE == display_config->buffering;
+#elif defined(HAGL_HAL_USE_SINGLE_BUFFER)
+    (void) display_config;
+    return true;
+#else
+    (void) display_config;
+    return false;
+#endif /* HAGL_HAL_USE_RUNTIME_BUFFER */
+}
 
 static inline uint16_t
 htons(uint16_t i)
 {
+#ifdef __arm__
     __asm ("rev16 %0, %0" : "+l" (i) : : );
+#else
+    /* Host build of the benchmark. */
+    i = __builtin_bswap16(i);
+#endif /* __arm__ */
     return i;
 }
 
+#ifdef HAGL_HAL_USE_SCROLL
+/*
+ * Rows of the vertical scrolling area are rotated in GRAM by the scroll
+ * offset. Map logical row to the GRAM row it is currently displayed from.
+ */
+static inline uint16_t
+mipi_display_scroll_y(const mipi_display_config_t *display_config, uint16_t y)
+{
+    uint16_t top = display_config->scroll_top;
+    uint16_t bottom = display_config->height - display_config->scroll_bottom;
+
+    if (y < top || y >= bottom) {
+        return y;
+    }
+    return top + (y - top + display_config->scroll_offset) % (bottom - top);
+}
+
+/* Number of rows starting from y which are consecutive also in GRAM. */
+static inline uint16_t
+mipi_display_scroll_rows(const mipi_display_config_t *display_config, uint16_t y, uint16_t h)
+{
+    uint16_t top = display_config->scroll_top;
+    uint16_t bottom = display_config->height - display_config->scroll_bottom;
+    uint16_t rows;
+
+    if (y < top) {
+        rows = top - y;
+    } else if (y >= bottom) {
+        rows = display_config->height - y;
+    } else {
+        rows = bottom - mipi_display_scroll_y(display_config, y);
+    }
+
+    return rows < h ? rows : h;
+}
+#endif /* HAGL_HAL_USE_SCROLL */
+
+#ifdef HAGL_HAL_USE_PIO
+static void mipi_display_set_address_xyxy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+/* Header word for the state machine, see mipi_display.pio. */
+#define MIPI_DISPLAY_PIO_COMMAND    (0u << 31)
+#define MIPI_DISPLAY_PIO_DATA       (1u << 31)
+
+static inline bool
+mipi_display_is_pio(const mipi_display_config_t *display_config)
+{
+    return MIPI_DISPLAY_TRANSPORT_PIO == display_config->transport;
+}
+
+/* DC is in-band so only the FIFO order matters, not the shifting. */
+static inline void
+mipi_display_pio_wait(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_COUNTERS
+    if (dma_channel_is_busy(display_config->pio_dma_control) || dma_channel_is_busy(display_config->pio_dma_data)) {
+        uint64_t start = time_us_64();
+        dma_channel_wait_for_finish_blocking(display_config->pio_dma_control);
+        dma_channel_wait_for_finish_blocking(display_config->pio_dma_data);
+        display_config->counters.dma_stall_time += time_us_64() - start;
+        return;
+    }
+#endif /* HAGL_HAL_USE_COUNTERS */
+    dma_channel_wait_for_finish_blocking(display_config->pio_dma_control);
+    dma_channel_wait_for_finish_blocking(display_config->pio_dma_data);
+}
+
+static void
+mipi_display_pio_wait_idle(mipi_display_config_t *display_config)
+{
+    uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + display_config->pio_sm);
+
+    mipi_display_pio_wait(display_config);
+
+    display_config->pio->fdebug = stall;
+    while (!(display_config->pio->fdebug & stall)) {};
+}
+
+static void
+mipi_display_pio_write(mipi_display_config_t *display_config, uint32_t dc, const uint8_t *data, size_t length)
+{
+    PIO pio = display_config->pio;
+    uint sm = display_config->pio_sm;
+
+    mipi_display_pio_wait(display_config);
+
+    pio_sm_put_blocking(pio, sm, dc | (length * 8 - 1));
+
+    while (length >= 4) {
+        pio_sm_put_blocking(pio, sm,
+                            (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 |
+                            (uint32_t) data[2] << 8 | (uint32_t) data[3]);
+        data += 4;
+        length -= 4;
+    }
+
+    if (length) {
+        uint32_t word = 0;
+        for (size_t i = 0; i < length; i++) {
+            word |= (uint32_t) data[i] << (24 - 8 * i);
+        }
+        pio_sm_put_blocking(pio, sm, word);
+    }
+}
+
+/* Pixels are stored in panel byte order, DMA byte swap makes words MSB first. */
+static void
+mipi_display_pio_write_dma(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+    PIO pio = display_config->pio;
+    uint sm = display_config->pio_sm;
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, length);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, buffer, length, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+    /* Unaligned buffer cannot be read a word at a time. */
+    if ((uintptr_t) buffer & 3) {
+        mipi_display_pio_write(display_config, MIPI_DISPLAY_PIO_DATA, buffer, length);
+        return;
+    }
+
+    mipi_display_pio_wait(display_config);
+
+    pio_sm_put_blocking(pio, sm, MIPI_DISPLAY_PIO_DATA | (length * 8 - 1));
+    dma_channel_configure(
+        display_config->pio_dma_data, &display_config->pio_dma_config,
+        &pio->txf[sm], buffer, (length + 3) / 4, true
+    );
+}
+
+static void
+mipi_display_pio_fill(mipi_display_config_t *display_config, uint16_t color, size_t count)
+{
+    PIO pio = display_config->pio;
+    uint sm = display_config->pio_sm;
+
+    mipi_display_pio_wait(display_config);
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, count * 2);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, (const uint8_t *) &color, 2, count);
+#endif /* HAGL_HAL_USE_TRACE */
+
+    /* Two pixels per word, DMA keeps reading this during the transfer. */
+    uint16_t swapped = htons(color);
+    display_config->pio_fill_word = (uint32_t) swapped << 16 | swapped;
+
+    dma_channel_config channel_config = display_config->pio_dma_config;
+    channel_config_set_read_increment(&channel_config, false);
+    channel_config_set_bswap(&channel_config, false);
+
+    pio_sm_put_blocking(pio, sm, MIPI_DISPLAY_PIO_DATA | (count * 16 - 1));
+    dma_channel_configure(
+        display_config->pio_dma_data, &channel_config,
+        &pio->txf[sm], &display_config->pio_fill_word, (count + 1) / 2, true
+    );
+}
+
+/*
+ * Address window, memory write command and the pixels are sent as one DMA
+ * chain. Control channel feeds the prebuilt command stream and then
+ * triggers the data channel.
+ */
+static void
+mipi_display_pio_write_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const uint8_t *buffer, size_t length)
+{
+    PIO pio = display_config->pio;
+    uint sm = display_config->pio_sm;
+    uint32_t *stream = display_config->pio_stream;
+    size_t count = 0;
+
+    /* Unaligned buffer cannot be read a word at a time. */
+    if ((uintptr_t) buffer & 3) {
+        mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
+#ifdef HAGL_HAL_USE_COUNTERS
+        mipi_display_count_data(display_config, length);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+        mipi_display_trace(display_config, 1, buffer, length, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+        mipi_display_pio_write(display_config, MIPI_DISPLAY_PIO_DATA, buffer, length);
+        return;
+    }
+
+    mipi_display_pio_wait(display_config);
+
+#ifdef HAGL_HAL_USE_SCROLL
+    uint16_t rows = y2 - y1;
+    y1 = mipi_display_scroll_y(display_config, y1);
+    y2 = y1 + rows;
+#endif /* HAGL_HAL_USE_SCROLL */
+
+    x1 = x1 + display_config->offset_x;
+    y1 = y1 + display_config->offset_y;
+    x2 = x2 + display_config->offset_x;
+    y2 = y2 + display_config->offset_y;
+
+    /* Change column address only if it has changed. */
+    if ((display_config->prev_clip.x0 != x1 || display_config->prev_clip.x1 != x2)) {
+        stream[count++] = MIPI_DISPLAY_PIO_COMMAND | 7;
+        stream[count++] = (uint32_t) MIPI_DCS_SET_COLUMN_ADDRESS << 24;
+        stream[count++] = MIPI_DISPLAY_PIO_DATA | 31;
+        stream[count++] = (uint32_t) x1 << 16 | x2;
+#ifdef HAGL_HAL_USE_TRACE
+        mipi_display_trace(display_config, 0, (uint8_t[]) {MIPI_DCS_SET_COLUMN_ADDRESS}, 1, 1);
+        mipi_display_trace(display_config, 1, (uint8_t[]) {x1 >> 8, x1 & 0xff, x2 >> 8, x2 & 0xff}, 4, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+        display_config->prev_clip.x0 = x1;
+        display_config->prev_clip.x1 = x2;
+    }
+
+    /* Change page address only if it has changed. */
+    if ((display_config->prev_clip.y0 != y1 || display_config->prev_clip.y1 != y2)) {
+        stream[count++] = MIPI_DISPLAY_PIO_COMMAND | 7;
+        stream[count++] = (uint32_t) MIPI_DCS_SET_PAGE_ADDRESS << 24;
+        stream[count++] = MIPI_DISPLAY_PIO_DATA | 31;
+        stream[count++] = (uint32_t) y1 << 16 | y2;
+#ifdef HAGL_HAL_USE_TRACE
+        mipi_display_trace(display_config, 0, (uint8_t[]) {MIPI_DCS_SET_PAGE_ADDRESS}, 1, 1);
+        mipi_display_trace(display_config, 1, (uint8_t[]) {y1 >> 8, y1 & 0xff, y2 >> 8, y2 & 0xff}, 4, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+        display_config->prev_clip.y0 = y1;
+        display_config->prev_clip.y1 = y2;
+    }
+
+    stream[count++] = MIPI_DISPLAY_PIO_COMMAND | 7;
+    stream[count++] = (uint32_t) MIPI_DCS_WRITE_MEMORY_START << 24;
+    stream[count++] = MIPI_DISPLAY_PIO_DATA | (length * 8 - 1);
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    /* Each address change is a command and four parameters. */
+    uint8_t changes = (count - 3) / 4;
+    display_config->counters.command_bytes += changes * 5 + 1;
+    display_config->counters.commands += changes + 1;
+    display_config->counters.pixel_bytes += length;
+    display_config->counters_pixels = true;
+    if (changes) {
+        display_config->counters.window_changes++;
+    } else {
+        display_config->counters.window_hits++;
+    }
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 0, (uint8_t[]) {MIPI_DCS_WRITE_MEMORY_START}, 1, 1);
+    mipi_display_trace(display_config, 1, buffer, length, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+    dma_channel_configure(
+        display_config->pio_dma_data, &display_config->pio_dma_config,
+        &pio->txf[sm], buffer, (length + 3) / 4, false
+    );
+
+    dma_channel_config channel_config = dma_channel_get_default_config(display_config->pio_dma_control);
+    channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_32);
+    channel_config_set_dreq(&channel_config, pio_get_dreq(pio, sm, true));
+    channel_config_set_chain_to(&channel_config, display_config->pio_dma_data);
+
+    dma_channel_configure(
+        display_config->pio_dma_control, &channel_config,
+        &pio->txf[sm], stream, count, true
+    );
+}
+
+static void
+mipi_display_pio_init(mipi_display_config_t *display_config)
+{
+    static int8_t offsets[2] = {-1, -1};
+
+    hagl_hal_debug("%s\n", "Initialising PIO.");
+
+    if (NULL == display_config->pio) {
+        display_config->pio = pio0;
+    }
+
+    PIO pio = display_config->pio;
+    uint index = pio_get_index(pio);
+
+    /* Displays on the same PIO share the program. */
+    if (offsets[index] < 0) {
+        offsets[index] = pio_add_program(pio, &mipi_display_program);
+    }
+
+    display_config->pio_sm = pio_claim_unused_sm(pio, true);
+
+    /* Two cycles per bit, never faster than sys_clk / 2. */
+    float clkdiv = (float) clock_get_hz(clk_sys) / (2.0f * display_config->spi_freq);
+    if (clkdiv < 1.0f) {
+        clkdiv = 1.0f;
+    }
+
+    mipi_display_program_init(
+        pio, display_config->pio_sm, offsets[index],
+        display_config->pin_mosi, display_config->pin_clk, display_config->pin_dc,
+        clkdiv
+    );
+    hagl_hal_debug("PIO clock divider is %d/100.\n", (int) (clkdiv * 100));
+
+    /* DC is driven by the state machine, CS stays low. */
+    gpio_init(display_config->pin_cs);
+    gpio_set_dir(display_config->pin_cs, GPIO_OUT);
+    gpio_put(display_config->pin_cs, 0);
+
+    display_config->pio_dma_control = dma_claim_unused_channel(true);
+    display_config->pio_dma_data = dma_claim_unused_channel(true);
+
+    dma_channel_config channel_config = dma_channel_get_default_config(display_config->pio_dma_data);
+    channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_32);
+    channel_config_set_bswap(&channel_config, true);
+    channel_config_set_dreq(&channel_config, pio_get_dreq(pio, display_config->pio_sm, true));
+    display_config->pio_dma_config = channel_config;
+}
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifdef HAGL_HAL_USE_DMA
+/*
+ * Called when DMA has finished. With fences this runs in the DMA interrupt
+ * or, if the interrupt cannot run yet, from the next write.
+ */
+static void
+mipi_display_dma_release(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_FENCE
+    /* Already released or the next transfer is running. */
+    if (display_config->fence_done == display_config->fence_started) {
+        return;
+    }
+    if (dma_channel_is_busy(display_config->dma_channel)) {
+        return;
+    }
+#endif /* HAGL_HAL_USE_FENCE */
+
+    /* Previous transfer must be out of the FIFO before DC can change. */
+    while (spi_get_hw(display_config->spi)->sr & SPI_SSPSR_BSY_BITS) {};
+    spi_get_hw(display_config->spi)->icr = SPI_SSPICR_RORIC_BITS;
+
+    /* DMA transfers are sent with 16 bit frames. */
+    if (16 == display_config->dma_data_bits) {
+        spi_set_format(display_config->spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+        display_config->dma_data_bits = 8;
+
+        /* Set CS high to ignore any traffic on SPI bus. */
+        gpio_put(display_config->pin_cs, 1);
+    }
+
+#ifdef HAGL_HAL_USE_FENCE
+    display_config->fence_done = display_config->fence_started;
+
+    mipi_display_fence_callback_t callback = display_config->fence_callback;
+    if (callback && (int32_t) (display_config->fence_done - display_config->fence_notify) >= 0) {
+        display_config->fence_callback = NULL;
+        callback(display_config, display_config->fence_notify, display_config->fence_arg);
+    }
+#endif /* HAGL_HAL_USE_FENCE */
+}
+
+static inline void
+mipi_display_dma_stall(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_COUNTERS
+    if (dma_channel_is_busy(display_config->dma_channel)) {
+        uint64_t start = time_us_64();
+        dma_channel_wait_for_finish_blocking(display_config->dma_channel);
+        display_config->counters.dma_stall_time += time_us_64() - start;
+        return;
+    }
+#endif /* HAGL_HAL_USE_COUNTERS */
+    dma_channel_wait_for_finish_blocking(display_config->dma_channel);
+}
+
+static inline void
+mipi_display_dma_finish(mipi_display_config_t *display_config)
+{
+    mipi_display_dma_stall(display_config);
+#ifdef HAGL_HAL_USE_FENCE
+    /* Interrupt of this transfer might not have run yet. */
+    uint32_t status = save_and_disable_interrupts();
+    mipi_display_dma_release(display_config);
+    restore_interrupts(status);
+#else
+    mipi_display_dma_release(display_config);
+#endif /* HAGL_HAL_USE_FENCE */
+}
+#endif /* HAGL_HAL_USE_DMA */
+
+#ifdef HAGL_HAL_USE_SHARED_BUS
+static void mipi_display_bus_dispatch(mipi_display_bus_t *bus);
+
+/*
+ * Displays sharing an SPI port take turns. The previous owner must have
+ * finished its transfer, switched back to 8 bit frames and raised its CS
+ * before another display can touch the bus. Writes queued while the bus
+ * was busy go first.
+ */
+static void
+mipi_display_bus_acquire(mipi_display_config_t *display_config)
+{
+    mipi_display_bus_t *bus = display_config->bus;
+
+    /* Bus was already handed over by the dispatcher. */
+    if (!bus || bus->dispatching) {
+        return;
+    }
+
+    while (bus->head != bus->tail) {
+        mipi_display_bus_dispatch(bus);
+        if (bus->head != bus->tail) {
+            __wfe();
+        }
+    }
+
+    if (bus->owner != display_config) {
+        if (bus->owner) {
+            mipi_display_dma_finish(bus->owner);
+        }
+        bus->owner = display_config;
+    }
+}
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+static inline void
+mipi_display_dma_wait(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_wait(display_config);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    mipi_display_bus_acquire(display_config);
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+#ifdef HAGL_HAL_USE_DMA
+    mipi_display_dma_finish(display_config);
+#endif /* HAGL_HAL_USE_DMA */
+
+#if !defined(HAGL_HAL_USE_PIO) && !defined(HAGL_HAL_USE_DMA)
+    (void) display_config;
+#endif
+}
+
 static void
 mipi_display_write_command(mipi_display_config_t *display_config, const uint8_t command)
 {
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_command(display_config, command);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 0, &command, 1, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_write(display_config, MIPI_DISPLAY_PIO_COMMAND, &command, 1);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    mipi_display_dma_wait(display_config);
+
     /* Set DC low to denote incoming command. */
     gpio_put(display_config->pin_dc, 0);
 
@@ -78,6 +603,22 @@ mipi_display_write_data(mipi_display_config_t *display_config, const uint8_t *da
         return;
     };
 
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, length);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, data, length, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_write(display_config, MIPI_DISPLAY_PIO_DATA, data, length);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    mipi_display_dma_wait(display_config);
+
     /* Set DC high to denote incoming data. */
     gpio_put(display_config->pin_dc, 1);
 
@@ -97,6 +638,27 @@ mipi_display_write_data(mipi_display_config_t *display_config, const uint8_t *da
     gpio_put(display_config->pin_cs, 1);
 }
 
+#ifdef HAGL_HAL_USE_DMA
+/*
+ * SPI stays in 16 bit mode between consecutive DMA transfers. It is
+ * switched back to 8 bit frames when the next command is written.
+ */
+static inline void
+mipi_display_dma_set_format(mipi_display_config_t *display_config)
+{
+    if (16 != display_config->dma_data_bits) {
+        /* Format can be changed only when idle. */
+        while (spi_get_hw(display_config->spi)->sr & SPI_SSPSR_BSY_BITS) {};
+        spi_set_format(display_config->spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+        display_config->dma_data_bits = 16;
+    }
+}
+
+/*
+ * Pixels are stored in panel byte order. Reading them as little endian
+ * halfwords and byte swapping in DMA sends them out in the same order
+ * with half the transfers and FIFO entries.
+ */
 static void
 mipi_display_write_data_dma(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
 {
@@ -104,53 +666,404 @@ mipi_display_write_data_dma(mipi_display_config_t *display_config, const uint8_t
         return;
     };
 
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_write_dma(display_config, buffer, length);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    /* Odd number of bytes cannot be sent with 16 bit frames. */
+    if (length & 1) {
+        mipi_display_write_data(display_config, buffer, length);
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, length);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, buffer, length, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    mipi_display_bus_acquire(display_config);
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+#ifdef HAGL_HAL_USE_FENCE
+    /* Interrupt releases CS after each transfer. */
+    mipi_display_dma_finish(display_config);
+#else
+    mipi_display_dma_stall(display_config);
+#endif /* HAGL_HAL_USE_FENCE */
+
+    /* Previous transfer might have been a fill. */
+    if (display_config->dma_fill) {
+        dma_channel_set_config(display_config->dma_channel, &display_config->dma_config, false);
+        display_config->dma_fill = false;
+    }
+
+    mipi_display_dma_set_format(display_config);
+
     /* Set DC high to denote incoming data. */
     gpio_put(display_config->pin_dc, 1);
 
     /* Set CS low to reserve the SPI bus. */
     gpio_put(display_config->pin_cs, 0);
 
-    dma_channel_wait_for_finish_blocking(dma_channel);
-    dma_channel_set_trans_count(dma_channel, length, false);
-    dma_channel_set_read_addr(dma_channel, buffer, true);
+    dma_channel_set_trans_count(display_config->dma_channel, length / 2, false);
+#ifdef HAGL_HAL_USE_FENCE
+    /* Interrupt must not see the count before the transfer is running. */
+    uint32_t status = save_and_disable_interrupts();
+    dma_channel_set_read_addr(display_config->dma_channel, buffer, true);
+    display_config->fence_started++;
+    restore_interrupts(status);
+#else
+    dma_channel_set_read_addr(display_config->dma_channel, buffer, true);
+#endif /* HAGL_HAL_USE_FENCE */
 }
 
+/*
+ * Repeats a single color with read increment disabled. DMA byte swap
+ * puts the color in panel byte order.
+ */
 static void
-mipi_display_dma_init(mipi_display_config_t *display_config)
+mipi_display_fill_data_dma(mipi_display_config_t *display_config, uint16_t color, size_t count)
 {
-    hagl_hal_debug("%s\n", "initialising DMA.");
+    mipi_display_dma_wait(display_config);
+    mipi_display_dma_set_format(display_config);
 
-    dma_channel = dma_claim_unused_channel(true);
-    dma_channel_config channel_config = dma_channel_get_default_config(dma_channel);
-    channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_8);
-    if (spi0 == display_config->spi) {
-        channel_config_set_dreq(&channel_config, DREQ_SPI0_TX);
-    } else {
-        channel_config_set_dreq(&channel_config, DREQ_SPI1_TX);
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, count * 2);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, (const uint8_t *) &color, 2, count);
+#endif /* HAGL_HAL_USE_TRACE */
+
+    /* Set DC high to denote incoming data. */
+    gpio_put(display_config->pin_dc, 1);
+
+    /* Set CS low to reserve the SPI bus. */
+    gpio_put(display_config->pin_cs, 0);
+
+    /* DMA keeps reading this while the transfer is running. */
+    display_config->dma_fill_color = color;
+
+    dma_channel_config channel_config = display_config->dma_config;
+    channel_config_set_read_increment(&channel_config, false);
+
+    dma_channel_set_config(display_config->dma_channel, &channel_config, false);
+    dma_channel_set_trans_count(display_config->dma_channel, count, false);
+#ifdef HAGL_HAL_USE_FENCE
+    uint32_t status = save_and_disable_interrupts();
+    dma_channel_set_read_addr(display_config->dma_channel, &display_config->dma_fill_color, true);
+    display_config->fence_started++;
+    restore_interrupts(status);
+#else
+    dma_channel_set_read_addr(display_config->dma_channel, &display_config->dma_fill_color, true);
+#endif /* HAGL_HAL_USE_FENCE */
+    display_config->dma_fill = true;
+
+#ifndef HAGL_HAL_USE_ASYNC_FILL
+    mipi_display_dma_wait(display_config);
+#endif /* HAGL_HAL_USE_ASYNC_FILL */
+}
+
+#endif /* HAGL_HAL_USE_DMA */
+
+#ifdef HAGL_HAL_USE_RGB444
+static inline bool
+mipi_display_is_rgb444(const mipi_display_config_t *display_config)
+{
+    return MIPI_DCS_PIXEL_FORMAT_12BIT == display_config->pixel_format;
+}
+
+/* Pixels are stored in panel byte order. */
+static inline uint16_t
+mipi_display_rgb444(uint16_t pixel)
+{
+    uint16_t color = htons(pixel);
+    return ((color >> 4) & 0x0f00) | ((color >> 3) & 0x00f0) | ((color >> 1) & 0x000f);
+}
+
+static inline void
+mipi_display_rgb444_send(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+#ifdef HAGL_HAL_USE_DMA
+    mipi_display_write_data_dma(display_config, buffer, length);
+#else
+    mipi_display_write_data(display_config, buffer, length);
+#endif /* HAGL_HAL_USE_DMA */
+}
+
+/*
+ * Pack RGB565 pixels to RGB444, two pixels to three bytes, and send them.
+ * Pixels are packed in chunks into two buffers in turns so with DMA the
+ * next chunk is packed while the previous one is being sent. Odd pixel
+ * is carried over to the next call so rows can be streamed one by one.
+ */
+static void
+mipi_display_rgb444_write(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+    const uint16_t *source = (const uint16_t *) buffer;
+    size_t count = length / 2;
+
+    while (count) {
+        uint8_t *start = (uint8_t *) display_config->rgb444_buffer[display_config->rgb444_current];
+        uint8_t *ptr = start;
+        size_t n = count < HAGL_HAL_RGB444_CHUNK ? count : HAGL_HAL_RGB444_CHUNK;
+
+        count -= n;
+
+        if (display_config->rgb444_pending) {
+            uint16_t first = display_config->rgb444_carry;
+            uint16_t second = mipi_display_rgb444(*(source++));
+            *(ptr++) = first >> 4;
+            *(ptr++) = (first << 4) | (second >> 8);
+            *(ptr++) = second;
+            display_config->rgb444_pending = false;
+            n--;
+        }
+
+        for (; n >= 2; n -= 2) {
+            uint16_t first = mipi_display_rgb444(*(source++));
+            uint16_t second = mipi_display_rgb444(*(source++));
+            *(ptr++) = first >> 4;
+            *(ptr++) = (first << 4) | (second >> 8);
+            *(ptr++) = second;
+        }
+
+        if (n) {
+            display_config->rgb444_carry = mipi_display_rgb444(*(source++));
+            display_config->rgb444_pending = true;
+        }
+
+        mipi_display_rgb444_send(display_config, start, ptr - start);
+        display_config->rgb444_current ^= 1;
     }
-    dma_channel_set_config(dma_channel, &channel_config, false);
-    dma_channel_set_write_addr(dma_channel, &spi_get_hw(display_config->spi)->dr, false);
 }
 
+/* Send the carried over pixel padded to two bytes. */
 static void
-mipi_display_read_data(mipi_display_config_t *display_config, uint8_t *data, size_t length)
+mipi_display_rgb444_finish(mipi_display_config_t *display_config)
 {
-    if (0 == length) {
-        return;
-    };
+    if (display_config->rgb444_pending) {
+        uint16_t carry = display_config->rgb444_carry;
+        uint8_t data[2] = {carry >> 4, carry << 4};
+        mipi_display_write_data(display_config, data, 2);
+        display_config->rgb444_pending = false;
+    }
 }
 
+/* Two pixels repeat every three bytes so fill from a prepacked chunk. */
 static void
-mipi_display_set_address_xyxy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+mipi_display_rgb444_fill(mipi_display_config_t *display_config, uint16_t color, size_t count)
 {
-    uint8_t command;
-    uint8_t data[4];
+    uint8_t *buffer = (uint8_t *) display_config->rgb444_buffer[0];
+    uint16_t pixel = mipi_display_rgb444(color);
+    size_t n = count < HAGL_HAL_RGB444_CHUNK ? count : HAGL_HAL_RGB444_CHUNK;
 
-    x1 = x1 + display_config->offset_x;
+    /* Buffer might still be in flight. */
+    mipi_display_dma_wait(display_config);
+
+    for (size_t i = 0; i < n / 2; i++) {
+        buffer[i * 3] = pixel >> 4;
+        buffer[i * 3 + 1] = (pixel << 4) | (pixel >> 8);
+        buffer[i * 3 + 2] = pixel;
+    }
+
+    /* DMA reads the same chunk over and over. */
+    for (; count >= HAGL_HAL_RGB444_CHUNK; count -= HAGL_HAL_RGB444_CHUNK) {
+        mipi_display_rgb444_send(display_config, buffer, HAGL_HAL_RGB444_CHUNK * 3 / 2);
+    }
+    mipi_display_rgb444_send(display_config, buffer, count / 2 * 3);
+
+    if (count & 1) {
+        display_config->rgb444_carry = pixel;
+        display_config->rgb444_pending = true;
+    }
+    mipi_display_rgb444_finish(display_config);
+
+    /* First buffer might still be in flight, pack the next write to second. */
+    display_config->rgb444_current = 1;
+}
+#endif /* HAGL_HAL_USE_RGB444 */
+
+#ifdef HAGL_HAL_USE_DMA
+static void
+mipi_display_dma_init(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_PIO
+    /* PIO transport has its own channels. */
+    if (mipi_display_is_pio(display_config)) {
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    hagl_hal_debug("%s\n", "initialising DMA.");
+
+    display_config->dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config channel_config = dma_channel_get_default_config(display_config->dma_channel);
+    channel_config_set_transfer_data_size(&channel_config, DMA_SIZE_16);
+    channel_config_set_bswap(&channel_config, true);
+    if (spi0 == display_config->spi) {
+        channel_config_set_dreq(&channel_config, DREQ_SPI0_TX);
+    } else {
+        channel_config_set_dreq(&channel_config, DREQ_SPI1_TX);
+    }
+    dma_channel_set_config(display_config->dma_channel, &channel_config, false);
+    dma_channel_set_write_addr(display_config->dma_channel, &spi_get_hw(display_config->spi)->dr, false);
+
+    display_config->dma_config = channel_config;
+    display_config->dma_data_bits = 8;
+    display_config->dma_fill = false;
+
+#ifdef HAGL_HAL_USE_FENCE
+    display_config->fence_started = 0;
+    display_config->fence_done = 0;
+    display_config->fence_callback = NULL;
+#endif /* HAGL_HAL_USE_FENCE */
+}
+#endif /* HAGL_HAL_USE_DMA */
+
+/*
+ * Command and the response are one transaction, CS stays low between them.
+ * Response is zeros when there is no MISO pin or with the PIO transport
+ * which is write only.
+ */
+static void
+mipi_display_read_command(mipi_display_config_t *display_config, const uint8_t command, uint8_t *data, size_t length)
+{
+    memset(data, 0, length);
+
+    if (display_config->pin_miso <= 0) {
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_command(display_config, command);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 0, &command, 1, 1);
+#endif /* HAGL_HAL_USE_TRACE */
+
+    mipi_display_dma_wait(display_config);
+    spi_set_baudrate(display_config->spi, MIPI_DISPLAY_SPI_READ_SPEED_HZ);
+
+    /* Set DC low to denote incoming command. */
+    gpio_put(display_config->pin_dc, 0);
+
+    /* Set CS low to reserve the SPI bus. */
+    gpio_put(display_config->pin_cs, 0);
+
+    spi_write_blocking(display_config->spi, &command, 1);
+    gpio_put(display_config->pin_dc, 1);
+    spi_read_blocking(display_config->spi, 0, data, length);
+
+    /* Set CS high to ignore any traffic on SPI bus. */
+    gpio_put(display_config->pin_cs, 1);
+
+    spi_set_baudrate(display_config->spi, display_config->spi_freq);
+}
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+static void
+mipi_display_power_set(mipi_display_config_t *display_config, uint8_t mode, const hagl_window_t *area)
+{
+    uint64_t now = time_us_64();
+
+    display_config->power_time[display_config->power_mode] += now - display_config->power_since;
+    display_config->power_since = now;
+
+    if (MIPI_DISPLAY_POWER_NORMAL == mode) {
+        mipi_display_write_command(display_config, MIPI_DCS_EXIT_IDLE_MODE);
+        mipi_display_write_command(display_config, MIPI_DCS_ENTER_NORMAL_MODE);
+        display_config->power_mode = mode;
+        hagl_hal_debug("%s\n", "Entering normal mode.");
+        return;
+    }
+
+    uint16_t x0 = area ? area->x0 : 0;
+    uint16_t x1 = area ? area->x1 : display_config->width - 1;
+    uint16_t y0 = (area ? area->y0 : 0) + display_config->offset_y;
+    uint16_t y1 = (area ? area->y1 : display_config->height - 1) + display_config->offset_y;
+
+    mipi_display_write_command(display_config, MIPI_DCS_SET_PARTIAL_ROWS);
+    mipi_display_write_data(display_config, (uint8_t[]) {y0 >> 8, y0 & 0xff, y1 >> 8, y1 & 0xff}, 4);
+
+    /* Partial columns is optional, send it only when needed. */
+    if (0 != x0 || display_config->width - 1 != x1) {
+        x0 += display_config->offset_x;
+        x1 += display_config->offset_x;
+        mipi_display_write_command(display_config, MIPI_DCS_SET_PARTIAL_COLUMNS);
+        mipi_display_write_data(display_config, (uint8_t[]) {x0 >> 8, x0 & 0xff, x1 >> 8, x1 & 0xff}, 4);
+    }
+
+    mipi_display_write_command(display_config, MIPI_DCS_ENTER_PARTIAL_MODE);
+    if (MIPI_DISPLAY_POWER_IDLE == mode) {
+        mipi_display_write_command(display_config, MIPI_DCS_ENTER_IDLE_MODE);
+    } else {
+        mipi_display_write_command(display_config, MIPI_DCS_EXIT_IDLE_MODE);
+    }
+
+    display_config->power_mode = mode;
+    hagl_hal_debug("Entering power mode %d.\n", mode);
+}
+
+/* Anything sent to the display wakes it up. */
+static inline void
+mipi_display_power_wake(mipi_display_config_t *display_config)
+{
+    if (MIPI_DISPLAY_POWER_NORMAL != display_config->power_mode) {
+        mipi_display_power_set(display_config, MIPI_DISPLAY_POWER_NORMAL, NULL);
+    }
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+static void
+mipi_display_set_address_xyxy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+#ifdef HAGL_HAL_USE_LOW_POWER
+    mipi_display_power_wake(display_config);
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+    uint8_t command;
+    uint8_t data[4];
+
+#ifdef HAGL_HAL_USE_RGB444
+    /* Pixel carried over from previous window belongs to it. */
+    mipi_display_rgb444_finish(display_config);
+#endif /* HAGL_HAL_USE_RGB444 */
+
+#ifdef HAGL_HAL_USE_SCROLL
+    /* Callers split windows which are not consecutive in GRAM. */
+    uint16_t rows = y2 - y1;
+    y1 = mipi_display_scroll_y(display_config, y1);
+    y2 = y1 + rows;
+#endif /* HAGL_HAL_USE_SCROLL */
+
+    x1 = x1 + display_config->offset_x;
     y1 = y1 + display_config->offset_y;
     x2 = x2 + display_config->offset_x;
     y2 = y2 + display_config->offset_y;
 
+#ifdef HAGL_HAL_USE_COUNTERS
+    if (
+        display_config->prev_clip.x0 != x1 || display_config->prev_clip.x1 != x2 ||
+        display_config->prev_clip.y0 != y1 || display_config->prev_clip.y1 != y2
+    ) {
+        display_config->counters.window_changes++;
+    } else {
+        display_config->counters.window_hits++;
+    }
+#endif /* HAGL_HAL_USE_COUNTERS */
+
     /* Change column address only if it has changed. */
     if ((display_config->prev_clip.x0 != x1 || display_config->prev_clip.x1 != x2)) {
         mipi_display_write_command(display_config, MIPI_DCS_SET_COLUMN_ADDRESS);
@@ -164,47 +1077,620 @@ mipi_display_set_address_xyxy(mipi_display_config_t *display_config, uint16_t x1
         display_config->prev_clip.x1 = x2;
     }
 
-    /* Change page address only if it has changed. */
-    if ((display_config->prev_clip.y0 != y1 || display_config->prev_clip.y1 != y2)) {
-        mipi_display_write_command(display_config, MIPI_DCS_SET_PAGE_ADDRESS);
-        data[0] = y1 >> 8;
-        data[1] = y1 & 0xff;
-        data[2] = y2 >> 8;
-        data[3] = y2 & 0xff;
-        mipi_display_write_data(display_config, data, 4);
+    /* Change page address only if it has changed. */
+    if ((display_config->prev_clip.y0 != y1 || display_config->prev_clip.y1 != y2)) {
+        mipi_display_write_command(display_config, MIPI_DCS_SET_PAGE_ADDRESS);
+        data[0] = y1 >> 8;
+        data[1] = y1 & 0xff;
+        data[2] = y2 >> 8;
+        data[3] = y2 & 0xff;
+        mipi_display_write_data(display_config, data, 4);
+
+        display_config->prev_clip.y0 = y1;
+        display_config->prev_clip.y1 = y2;
+    }
+
+    mipi_display_write_command(display_config, MIPI_DCS_WRITE_MEMORY_START);
+}
+
+static void
+mipi_display_set_address_xy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1)
+{
+    uint8_t command;
+    uint8_t data[2];
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    mipi_display_power_wake(display_config);
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_SCROLL
+    y1 = mipi_display_scroll_y(display_config, y1);
+#endif /* HAGL_HAL_USE_SCROLL */
+
+    x1 = x1 + display_config->offset_x;
+    y1 = y1 + display_config->offset_y;
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    /* Single pixel window is always sent. */
+    display_config->counters.window_changes++;
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+    mipi_display_write_command(display_config, MIPI_DCS_SET_COLUMN_ADDRESS);
+    data[0] = x1 >> 8;
+    data[1] = x1 & 0xff;
+    mipi_display_write_data(display_config, data, 2);
+
+    mipi_display_write_command(display_config, MIPI_DCS_SET_PAGE_ADDRESS);
+    data[0] = y1 >> 8;
+    data[1] = y1 & 0xff;
+    mipi_display_write_data(display_config, data, 2);
+
+    mipi_display_write_command(display_config, MIPI_DCS_WRITE_MEMORY_START);
+}
+
+/*
+ * Rising edge of TE marks the start of vertical blanking. All displays
+ * share one handler which also runs the jobs submitted for vblank. Event
+ * is signalled so that a core waiting in mipi_display_vblank_wait() wakes
+ * up also when the interrupt was handled by the other core.
+ */
+#define MIPI_DISPLAY_TE_DISPLAYS    (4)
+
+static mipi_display_config_t *te_displays[MIPI_DISPLAY_TE_DISPLAYS];
+static uint8_t te_display_count = 0;
+
+static void
+mipi_display_te_irq(void)
+{
+    for (uint8_t i = 0; i < te_display_count; i++) {
+        mipi_display_config_t *display_config = te_displays[i];
+
+        if (!(gpio_get_irq_event_mask(display_config->pin_te) & GPIO_IRQ_EDGE_RISE)) {
+            continue;
+        }
+        gpio_acknowledge_irq(display_config->pin_te, GPIO_IRQ_EDGE_RISE);
+
+        /*
+         * Track the refresh period. Interval spanning a missed edge, for
+         * example while a long job was running, is ignored.
+         */
+        uint64_t now = time_us_64();
+        uint32_t period = display_config->vblank_period;
+        uint32_t interval = now - display_config->vblank_time;
+        if (display_config->vblank_count > 0) {
+            if (0 == period) {
+                display_config->vblank_period = interval;
+            } else if (interval < period + period / 2) {
+                display_config->vblank_period = (period * 3 + interval) / 4;
+            }
+        }
+
+        display_config->vblank_time = now;
+        display_config->vblank_count++;
+
+        mipi_display_job_t job = display_config->vblank_job;
+        if (job) {
+            display_config->vblank_running = true;
+            display_config->vblank_sent = job(display_config->vblank_arg);
+            display_config->vblank_running = false;
+            display_config->vblank_job = NULL;
+        }
+    }
+    __sev();
+}
+
+static void
+mipi_display_te_init(mipi_display_config_t *display_config)
+{
+    if (MIPI_DISPLAY_TE_DISPLAYS == te_display_count) {
+        hagl_hal_debug("No room for TE of display %p, polling.\n", (void *) display_config);
+        return;
+    }
+
+    display_config->vblank_count = 0;
+    display_config->vblank_time = 0;
+    display_config->vblank_period = 0;
+
+    if (0 == te_display_count) {
+        gpio_add_raw_irq_handler(display_config->pin_te, mipi_display_te_irq);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+    te_displays[te_display_count++] = display_config;
+
+    gpio_set_irq_enabled(display_config->pin_te, GPIO_IRQ_EDGE_RISE, true);
+}
+
+static inline bool
+mipi_display_has_te_irq(const mipi_display_config_t *display_config)
+{
+    for (uint8_t i = 0; i < te_display_count; i++) {
+        if (te_displays[i] == display_config) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+mipi_display_vblank_wait(mipi_display_config_t *display_config)
+{
+    if (display_config->pin_te <= 0) {
+        return;
+    }
+
+    /* Job submitted for vblank is already running in it. */
+    if (display_config->vblank_running) {
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    uint64_t start = time_us_64();
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+    if (!mipi_display_has_te_irq(display_config)) {
+        while (!gpio_get(display_config->pin_te)) {}
+    } else {
+        uint32_t count = display_config->vblank_count;
+        while (count == display_config->vblank_count) {
+            __wfe();
+        }
+    }
+
+#ifdef HAGL_HAL_USE_COUNTERS
+    display_config->counters.te_wait_time += time_us_64() - start;
+#endif /* HAGL_HAL_USE_COUNTERS */
+}
+
+uint32_t
+mipi_display_vblank(mipi_display_config_t *display_config, uint64_t *time)
+{
+    if (time) {
+        *time = display_config->vblank_time;
+    }
+    return display_config->vblank_count;
+}
+
+uint32_t
+mipi_display_vblank_phase(mipi_display_config_t *display_config)
+{
+    uint32_t period = display_config->vblank_period;
+    if (0 == period) {
+        return 0;
+    }
+    return (time_us_64() - display_config->vblank_time) % period;
+}
+
+void
+mipi_display_vblank_wait_phase(mipi_display_config_t *display_config, uint32_t phase)
+{
+    uint32_t period = display_config->vblank_period;
+    if (0 == period) {
+        mipi_display_vblank_wait(display_config);
+        return;
+    }
+
+    uint32_t now = mipi_display_vblank_phase(display_config);
+    if (now < phase) {
+        sleep_us(phase - now);
+    } else if (now > phase) {
+        sleep_us(period - now + phase);
+    }
+}
+
+void
+mipi_display_vblank_submit(mipi_display_config_t *display_config, mipi_display_job_t job, const void *arg)
+{
+    mipi_display_vblank_sync(display_config);
+
+    /* Without TE interrupt there is nothing to wait for. */
+    if (!mipi_display_has_te_irq(display_config)) {
+        display_config->vblank_sent = job(arg);
+        return;
+    }
+
+    display_config->vblank_arg = arg;
+    __dmb();
+    display_config->vblank_job = job;
+}
+
+size_t
+mipi_display_vblank_sync(mipi_display_config_t *display_config)
+{
+    while (display_config->vblank_job) {
+        __wfe();
+    }
+    __dmb();
+
+    /* Buffer can be reused only after the transfer has finished. */
+    mipi_display_sync(display_config);
+
+    size_t sent = display_config->vblank_sent;
+    display_config->vblank_sent = 0;
+    return sent;
+}
+
+#ifdef HAGL_HAL_USE_SHARED_BUS
+/*
+ * Start the next queued window write if the bus is free. Command phase of
+ * a write is blocking SPI so this runs in thread context, the DMA
+ * interrupt only wakes up a core waiting for the bus. Writes are started
+ * with the normal write path so address caching of each display stays
+ * valid.
+ */
+static void
+mipi_display_bus_dispatch(mipi_display_bus_t *bus)
+{
+    if (bus->head == bus->tail || bus->dispatching) {
+        return;
+    }
+
+    mipi_display_config_t *owner = bus->owner;
+    if (owner && dma_channel_is_busy(owner->dma_channel)) {
+        return;
+    }
+
+    mipi_display_bus_request_t *request = &bus->queue[bus->tail % MIPI_DISPLAY_BUS_QUEUE];
+    mipi_display_config_t *display_config = request->display_config;
+
+    if (owner != display_config) {
+        if (owner) {
+            mipi_display_dma_finish(owner);
+        }
+        bus->owner = display_config;
+    }
+
+    bus->dispatching = true;
+    mipi_display_write_xywh(
+        display_config,
+        request->x1, request->y1, request->w, request->h,
+        (uint8_t *) request->buffer
+    );
+    bus->dispatching = false;
+    bus->tail++;
+    display_config->bus_pending--;
+}
+
+static void
+mipi_display_bus_register(mipi_display_config_t *display_config)
+{
+    display_config->bus_pending = 0;
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        hagl_hal_debug("Display %p uses PIO, not sharing the bus.\n", (void *) display_config);
+        display_config->bus = NULL;
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    if (display_config->bus->spi != display_config->spi) {
+        hagl_hal_debug("Display %p is not on the SPI port of its bus.\n", (void *) display_config);
+    }
+}
+
+void
+mipi_display_bus_init(mipi_display_bus_t *bus, spi_inst_t *spi)
+{
+    bus->spi = spi;
+    bus->owner = NULL;
+    bus->head = 0;
+    bus->tail = 0;
+    bus->dispatching = false;
+}
+
+size_t
+mipi_display_bus_write_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, const uint8_t *buffer)
+{
+    mipi_display_bus_t *bus = display_config->bus;
+
+    if (bus) {
+        /* Queued writes go first if the bus became free meanwhile. */
+        mipi_display_bus_dispatch(bus);
+
+        mipi_display_config_t *owner = bus->owner;
+        bool busy = (bus->head != bus->tail) || (owner && dma_channel_is_busy(owner->dma_channel));
+        uint8_t queued = bus->head - bus->tail;
+
+        /* Started by the next dispatch after the bus becomes free. */
+        if (busy && queued < MIPI_DISPLAY_BUS_QUEUE) {
+            mipi_display_bus_request_t *request = &bus->queue[bus->head % MIPI_DISPLAY_BUS_QUEUE];
+            request->display_config = display_config;
+            request->x1 = x1;
+            request->y1 = y1;
+            request->w = w;
+            request->h = h;
+            request->buffer = buffer;
+            bus->head++;
+            display_config->bus_pending++;
+            return w * h * (display_config->depth / 8);
+        }
+    }
+
+    return mipi_display_write_xywh(display_config, x1, y1, w, h, (uint8_t *) buffer);
+}
+
+void
+mipi_display_bus_poll(mipi_display_bus_t *bus)
+{
+    mipi_display_bus_dispatch(bus);
+}
+
+/*
+ * Unlike mipi_display_sync() this does not wait for the other displays
+ * longer than it takes to send the writes queued before ours.
+ */
+void
+mipi_display_bus_sync(mipi_display_config_t *display_config)
+{
+    while (display_config->bus_pending) {
+        mipi_display_bus_dispatch(display_config->bus);
+        if (display_config->bus_pending) {
+            __wfe();
+        }
+    }
+    dma_channel_wait_for_finish_blocking(display_config->dma_channel);
+}
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+
+#if defined(HAGL_HAL_USE_SHARED_BUS) || defined(HAGL_HAL_USE_FENCE)
+/*
+ * One handler serves the DMA channels of all displays. Finished transfer
+ * signals the fence and wakes up a core waiting for the shared bus. Queued
+ * writes are not started here, see mipi_display_bus_dispatch().
+ */
+#define MIPI_DISPLAY_DMA_DISPLAYS   (4)
+
+static mipi_display_config_t *dma_displays[MIPI_DISPLAY_DMA_DISPLAYS];
+static uint8_t dma_display_count = 0;
+
+static void
+mipi_display_dma_irq(void)
+{
+    for (uint8_t i = 0; i < dma_display_count; i++) {
+        mipi_display_config_t *display_config = dma_displays[i];
+
+        if (!dma_channel_get_irq0_status(display_config->dma_channel)) {
+            continue;
+        }
+        dma_channel_acknowledge_irq0(display_config->dma_channel);
+
+#ifdef HAGL_HAL_USE_FENCE
+        mipi_display_dma_release(display_config);
+#endif /* HAGL_HAL_USE_FENCE */
+    }
+    __sev();
+}
+
+static void
+mipi_display_dma_irq_init(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_PIO
+    /* PIO transport has its own channels. */
+    if (mipi_display_is_pio(display_config)) {
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifndef HAGL_HAL_USE_FENCE
+    if (!display_config->bus) {
+        return;
+    }
+#endif /* HAGL_HAL_USE_FENCE */
+
+    if (MIPI_DISPLAY_DMA_DISPLAYS == dma_display_count) {
+        hagl_hal_debug("No room for DMA interrupt of display %p.\n", (void *) display_config);
+#ifdef HAGL_HAL_USE_SHARED_BUS
+        /* Core waiting for the bus would never be woken up. */
+        display_config->bus = NULL;
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+        return;
+    }
+
+    if (0 == dma_display_count) {
+        irq_add_shared_handler(DMA_IRQ_0, mipi_display_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+    dma_displays[dma_display_count++] = display_config;
+
+    dma_channel_set_irq0_enabled(display_config->dma_channel, true);
+}
+#endif /* HAGL_HAL_USE_SHARED_BUS || HAGL_HAL_USE_FENCE */
+
+#ifdef HAGL_HAL_USE_FENCE
+mipi_display_fence_t
+mipi_display_fence(mipi_display_config_t *display_config)
+{
+    return display_config->fence_started;
+}
+
+bool
+mipi_display_fence_poll(mipi_display_config_t *display_config, mipi_display_fence_t fence)
+{
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        return !dma_channel_is_busy(display_config->pio_dma_control)
+            && !dma_channel_is_busy(display_config->pio_dma_data);
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+    if ((int32_t) (display_config->fence_done - fence) >= 0) {
+        return true;
+    }
+
+    /* Works also when the interrupt could not be registered. */
+    if (!dma_channel_is_busy(display_config->dma_channel)) {
+        uint32_t status = save_and_disable_interrupts();
+        mipi_display_dma_release(display_config);
+        restore_interrupts(status);
+    }
+
+    return (int32_t) (display_config->fence_done - fence) >= 0;
+}
+
+void
+mipi_display_fence_wait(mipi_display_config_t *display_config, mipi_display_fence_t fence)
+{
+    while (!mipi_display_fence_poll(display_config, fence)) {};
+}
+
+void
+mipi_display_fence_notify(mipi_display_config_t *display_config, mipi_display_fence_t fence, mipi_display_fence_callback_t callback, void *arg)
+{
+    uint32_t status = save_and_disable_interrupts();
+    if ((int32_t) (display_config->fence_done - fence) < 0) {
+        display_config->fence_notify = fence;
+        display_config->fence_arg = arg;
+        display_config->fence_callback = callback;
+        restore_interrupts(status);
+        return;
+    }
+    restore_interrupts(status);
+
+    /* Already signalled. */
+    callback(display_config, fence, arg);
+}
+#endif /* HAGL_HAL_USE_FENCE */
+
+#ifdef HAGL_HAL_USE_MULTICORE
+/*
+ * Core 1 owns the SPI bus. Core 0 pushes the display config, the job and
+ * its argument to the FIFO and continues rendering the next frame.
+ */
+static void
+mipi_display_core1_entry(void)
+{
+    while (1) {
+        mipi_display_config_t *display_config = (mipi_display_config_t *) (uintptr_t) multicore_fifo_pop_blocking();
+        mipi_display_job_t job = (mipi_display_job_t) (uintptr_t) multicore_fifo_pop_blocking();
+        const void *arg = (const void *) (uintptr_t) multicore_fifo_pop_blocking();
+
+        size_t sent = job(arg);
+
+        /* Buffer can be reused only after the transfer has finished. */
+        mipi_display_dma_wait(display_config);
+
+        display_config->sent = sent;
+        __dmb();
+        display_config->busy = false;
+        __sev();
+    }
+}
+
+static void
+mipi_display_core1_init(void)
+{
+    static bool running = false;
+
+    /* One service loop handles all displays. */
+    if (!running) {
+        hagl_hal_debug("%s\n", "Launching display service on core 1.");
+        multicore_launch_core1(mipi_display_core1_entry);
+        running = true;
+    }
+}
+
+void
+mipi_display_submit(mipi_display_config_t *display_config, mipi_display_job_t job, const void *arg)
+{
+    mipi_display_wait(display_config);
+
+    display_config->busy = true;
+    __dmb();
+
+    multicore_fifo_push_blocking((uintptr_t) display_config);
+    multicore_fifo_push_blocking((uintptr_t) job);
+    multicore_fifo_push_blocking((uintptr_t) arg);
+}
+
+size_t
+mipi_display_wait(mipi_display_config_t *display_config)
+{
+    while (display_config->busy) {
+        __wfe();
+    }
+    __dmb();
+
+    size_t sent = display_config->sent;
+    display_config->sent = 0;
+    return sent;
+}
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+/* Init sequence step, delay is in milliseconds after the command. */
+typedef struct {
+    uint8_t     command;
+    uint8_t     length;
+    uint8_t     data;
+    uint8_t     delay;
+} mipi_display_init_t;
+
+static void
+mipi_display_init_sequence(mipi_display_config_t *display_config, const mipi_display_init_t *sequence, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        mipi_display_write_command(display_config, sequence[i].command);
+        mipi_display_write_data(display_config, &sequence[i].data, sequence[i].length);
+        if (sequence[i].delay) {
+            sleep_ms(sequence[i].delay);
+        }
+    }
+}
+
+/* Power mode of the panel, zero if it cannot be read. */
+static uint8_t
+mipi_display_power_state(mipi_display_config_t *display_config)
+{
+    uint8_t mode;
 
-        display_config->prev_clip.y0 = y1;
-        display_config->prev_clip.y1 = y2;
+    mipi_display_read_command(display_config, MIPI_DCS_GET_POWER_MODE, &mode, 1);
+
+    /* Lowest bits are always zero, floating MISO reads as all ones. */
+    if (mode & 0x03) {
+        return 0;
     }
 
-    mipi_display_write_command(display_config, MIPI_DCS_WRITE_MEMORY_START);
+    return mode;
 }
 
+/* Hardware reset if there is a reset pin, software reset otherwise. */
 static void
-mipi_display_set_address_xy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1)
+mipi_display_reset(mipi_display_config_t *display_config, uint32_t delay)
 {
-    uint8_t command;
-    uint8_t data[2];
-
-    x1 = x1 + display_config->offset_x;
-    y1 = y1 + display_config->offset_y;
+    if (display_config->pin_rst > 0) {
+        gpio_set_function(display_config->pin_rst, GPIO_FUNC_SIO);
+        gpio_set_dir(display_config->pin_rst, GPIO_OUT);
 
-    mipi_display_write_command(display_config, MIPI_DCS_SET_COLUMN_ADDRESS);
-    data[0] = x1 >> 8;
-    data[1] = x1 & 0xff;
-    mipi_display_write_data(display_config, data, 2);
+        /* Pulse must be at least 10 us. */
+        gpio_put(display_config->pin_rst, 0);
+        sleep_us(20);
+        gpio_put(display_config->pin_rst, 1);
+    } else {
+        mipi_display_write_command(display_config, MIPI_DCS_SOFT_RESET);
+    }
 
-    mipi_display_write_command(display_config, MIPI_DCS_SET_PAGE_ADDRESS);
-    data[0] = y1 >> 8;
-    data[1] = y1 & 0xff;
-    mipi_display_write_data(display_config, data, 2);
+    sleep_ms(delay);
+}
 
-    mipi_display_write_command(display_config, MIPI_DCS_WRITE_MEMORY_START);
+#ifdef HAGL_HAL_USE_FAST_WAKE
+static int64_t
+mipi_display_backlight_alarm(alarm_id_t id, void *pin)
+{
+    (void) id;
+    gpio_put((uint) (uintptr_t) pin, 1);
+    return 0;
 }
+#endif /* HAGL_HAL_USE_FAST_WAKE */
 
 static void
 mipi_display_spi_master_init(mipi_display_config_t *display_config)
 {
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_init(display_config);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
     if (display_config->init_spi > 0) {
         hagl_hal_debug("%s\n", "Initialising SPI.");
 
@@ -235,6 +1721,30 @@ mipi_display_spi_master_init(mipi_display_config_t *display_config)
 
 }
 
+#ifdef HAGL_HAL_USE_SCROLL
+/* Sends the scroll area and start, caller makes sure the bus is free. */
+static void
+mipi_display_scroll_area_send(mipi_display_config_t *display_config, uint16_t top, uint16_t bottom)
+{
+    uint16_t gram_height = display_config->gram_height ? display_config->gram_height : display_config->height;
+    uint16_t tfa = top + display_config->offset_y;
+    uint16_t vsa = display_config->height - top - bottom;
+    /* Rows of display memory below the visible ones do not scroll. */
+    uint16_t bfa = gram_height - tfa - vsa;
+    uint8_t data[6] = {tfa >> 8, tfa & 0xff, vsa >> 8, vsa & 0xff, bfa >> 8, bfa & 0xff};
+
+    mipi_display_write_command(display_config, MIPI_DCS_SET_SCROLL_AREA);
+    mipi_display_write_data(display_config, data, 6);
+
+    display_config->scroll_top = top;
+    display_config->scroll_bottom = bottom;
+    display_config->scroll_offset = 0;
+
+    mipi_display_write_command(display_config, MIPI_DCS_SET_SCROLL_START);
+    mipi_display_write_data(display_config, (uint8_t[]) {tfa >> 8, tfa & 0xff}, 2);
+}
+#endif /* HAGL_HAL_USE_SCROLL */
+
 void
 mipi_display_init(mipi_display_config_t *display_config)
 {
@@ -252,53 +1762,82 @@ mipi_display_init(mipi_display_config_t *display_config)
 
     /* Init the spi driver. */
     mipi_display_spi_master_init(display_config);
-    sleep_ms(100);
 
-    /* Reset the display. */
-    if (display_config->pin_rst > 0) {
-        gpio_set_function(display_config->pin_rst, GPIO_FUNC_SIO);
-        gpio_set_dir(display_config->pin_rst, GPIO_OUT);
+#ifdef HAGL_HAL_USE_DMA
+    mipi_display_dma_init(display_config);
+#endif /* HAGL_HAL_USE_DMA */
 
-        gpio_put(display_config->pin_rst, 0);
-        sleep_ms(100);
-        gpio_put(display_config->pin_rst, 1);
-        sleep_ms(100);
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    if (display_config->bus) {
+        mipi_display_bus_register(display_config);
     }
+#endif /* HAGL_HAL_USE_SHARED_BUS */
 
-    /* Send minimal init commands. */
-    mipi_display_write_command(display_config, MIPI_DCS_SOFT_RESET);
-    sleep_ms(200);
+#if defined(HAGL_HAL_USE_SHARED_BUS) || defined(HAGL_HAL_USE_FENCE)
+    mipi_display_dma_irq_init(display_config);
+#endif /* HAGL_HAL_USE_SHARED_BUS || HAGL_HAL_USE_FENCE */
 
-    mipi_display_write_command(display_config, MIPI_DCS_SET_ADDRESS_MODE);
-    mipi_display_write_data(display_config, &(uint8_t) {display_config->address_mode}, 1);
+    /* Panel which is already awake needs only the settings. */
+    uint8_t power = mipi_display_power_state(display_config);
+    bool awake = (power & MIPI_DCS_POWER_MODE_SLEEP_OUT) && (power & MIPI_DCS_POWER_MODE_DISPLAY_ON);
 
-    mipi_display_write_command(display_config, MIPI_DCS_SET_PIXEL_FORMAT);
-    mipi_display_write_data(display_config, &(uint8_t) {display_config->pixel_format}, 1);
-
-    if (display_config->pin_te > 0) {
-        mipi_display_write_command(display_config, MIPI_DCS_SET_TEAR_ON);
-        mipi_display_write_data(display_config, &(uint8_t) {MIPI_DCS_SET_TEAR_ON_VSYNC}, 1);
-        hagl_hal_debug("Enable vsync notification on pin %d\n", display_config->pin_te);
+    /* Partial and idle modes left from before the reboot need a reset. */
+    if (!(power & MIPI_DCS_POWER_MODE_NORMAL_ON) || (power & (MIPI_DCS_POWER_MODE_PARTIAL_ON | MIPI_DCS_POWER_MODE_IDLE_ON))) {
+        awake = false;
     }
 
-    if (display_config->invert > 0) {
-        mipi_display_write_command(display_config, MIPI_DCS_ENTER_INVERT_MODE);
-        hagl_hal_debug("%s\n", "Inverting display.");
+    const mipi_display_init_t sequence[] = {
+        {MIPI_DCS_EXIT_SLEEP_MODE, 0, 0, MIPI_DISPLAY_COMMAND_DELAY_MS},
+        {MIPI_DCS_SET_ADDRESS_MODE, 1, display_config->address_mode, 0},
+        {MIPI_DCS_SET_PIXEL_FORMAT, 1, display_config->pixel_format, 0},
+        {
+            display_config->pin_te > 0 ? MIPI_DCS_SET_TEAR_ON : MIPI_DCS_SET_TEAR_OFF,
+            display_config->pin_te > 0 ? 1 : 0, MIPI_DCS_SET_TEAR_ON_VSYNC, 0
+        },
+        {display_config->invert > 0 ? MIPI_DCS_ENTER_INVERT_MODE : MIPI_DCS_EXIT_INVERT_MODE, 0, 0, 0},
+        /* Also leaves vertical scrolling mode after a warm boot. */
+        {MIPI_DCS_ENTER_NORMAL_MODE, 0, 0, 0},
+        {MIPI_DCS_SET_DISPLAY_ON, 0, 0, 0},
+    };
+
+    size_t count = sizeof(sequence) / sizeof(mipi_display_init_t);
+    absolute_time_t wake = get_absolute_time();
+
+    if (awake) {
+        hagl_hal_debug("%s\n", "Display is awake, skipping reset.");
+        mipi_display_init_sequence(display_config, sequence + 1, count - 1);
     } else {
-        mipi_display_write_command(display_config, MIPI_DCS_EXIT_INVERT_MODE);
-    }
+        /* Reset takes longer if the panel was, or is assumed to be, out of sleep. */
+        if ((0 == power && MIPI_DISPLAY_ASSUME_AWAKE) || (power & MIPI_DCS_POWER_MODE_SLEEP_OUT)) {
+            mipi_display_reset(display_config, MIPI_DISPLAY_RESET_AWAKE_DELAY_MS);
+        } else {
+            mipi_display_reset(display_config, MIPI_DISPLAY_RESET_DELAY_MS);
+        }
 
-    mipi_display_write_command(display_config, MIPI_DCS_EXIT_SLEEP_MODE);
-    sleep_ms(200);
+        /* Rest of the sequence is sent while the panel wakes up. */
+        wake = make_timeout_time_ms(MIPI_DISPLAY_SLEEP_OUT_DELAY_MS);
+        mipi_display_init_sequence(display_config, sequence, count);
+#ifndef HAGL_HAL_USE_FAST_WAKE
+        sleep_until(wake);
+#endif /* HAGL_HAL_USE_FAST_WAKE */
+    }
 
-    mipi_display_write_command(display_config, MIPI_DCS_SET_DISPLAY_ON);
-    sleep_ms(200);
+    if (display_config->pin_te > 0) {
+        hagl_hal_debug("Enable vsync notification on pin %d\n", display_config->pin_te);
+    }
 
     /* Enable backlight */
     if (display_config->pin_bl > 0) {
         gpio_set_function(display_config->pin_bl, GPIO_FUNC_SIO);
         gpio_set_dir(display_config->pin_bl, GPIO_OUT);
+#ifdef HAGL_HAL_USE_FAST_WAKE
+        /* First frame can be sent while the panel settles, light it after. */
+        if (add_alarm_at(wake, mipi_display_backlight_alarm, (void *) (uintptr_t) display_config->pin_bl, true) < 0) {
+            gpio_put(display_config->pin_bl, 1);
+        }
+#else
         gpio_put(display_config->pin_bl, 1);
+#endif /* HAGL_HAL_USE_FAST_WAKE */
     }
 
     /* Enable power */
@@ -309,19 +1848,55 @@ mipi_display_init(mipi_display_config_t *display_config)
     }
 
     /* Initialise vsync pin */
+    display_config->vblank_period = 0;
+    display_config->vblank_job = NULL;
+    display_config->vblank_sent = 0;
+    display_config->vblank_running = false;
     if (display_config->pin_te > 0) {
         gpio_set_function(display_config->pin_te, GPIO_FUNC_SIO);
         gpio_set_dir(display_config->pin_te, GPIO_IN);
         gpio_pull_up(display_config->pin_te);
+        mipi_display_te_init(display_config);
+    }
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+    display_config->power_mode = MIPI_DISPLAY_POWER_NORMAL;
+    display_config->power_since = time_us_64();
+    for (uint8_t i = 0; i < MIPI_DISPLAY_POWER_MODES; i++) {
+        display_config->power_time[i] = 0;
     }
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_SCROLL
+    display_config->scroll_top = 0;
+    display_config->scroll_bottom = 0;
+    display_config->scroll_offset = 0;
+    display_config->stream_h = 0;
+    if (awake) {
+        /* Scroll area survives a warm boot, reset it to the whole display. */
+        mipi_display_scroll_area_send(display_config, 0, 0);
+    }
+#endif /* HAGL_HAL_USE_SCROLL */
+
+#ifdef HAGL_HAL_USE_RGB444
+    display_config->rgb444_current = 0;
+    display_config->rgb444_pending = false;
+#endif /* HAGL_HAL_USE_RGB444 */
 
     /* Set the default viewport to full screen. */
     mipi_display_set_address_xyxy(display_config, 0, 0, display_config->width - 1, display_config->height - 1);
 
+#ifdef HAGL_HAL_USE_COUNTERS
+    /* Count from the first frame, not the init sequence. */
+    mipi_display_counters_reset(display_config);
+#endif /* HAGL_HAL_USE_COUNTERS */
+
 #ifdef HAGL_HAS_HAL_BACK_BUFFER
-#ifdef HAGL_HAL_USE_DMA
-    mipi_display_dma_init();
-#endif /* HAGL_HAL_USE_DMA */
+#ifdef HAGL_HAL_USE_MULTICORE
+    display_config->busy = false;
+    display_config->sent = 0;
+    mipi_display_core1_init();
+#endif /* HAGL_HAL_USE_MULTICORE */
 #endif /* HAGL_HAS_HAL_BACK_BUFFER */
 }
 
@@ -332,6 +1907,15 @@ mipi_display_fill_xywh(mipi_display_config_t *display_config, uint16_t x1, uint1
         return 0;
     }
 
+#ifdef HAGL_HAL_USE_SCROLL
+    uint16_t rows = mipi_display_scroll_rows(display_config, y1, h);
+    if (rows < h) {
+        /* Window wraps around in GRAM, fill it in parts. */
+        size_t sent = mipi_display_fill_xywh(display_config, x1, y1, w, rows, _color);
+        return sent + mipi_display_fill_xywh(display_config, x1, y1 + rows, w, h - rows, _color);
+    }
+#endif /* HAGL_HAL_USE_SCROLL */
+
     int32_t x2 = x1 + w - 1;
     int32_t y2 = y1 + h - 1;
     size_t size = w * h;
@@ -339,18 +1923,43 @@ mipi_display_fill_xywh(mipi_display_config_t *display_config, uint16_t x1, uint1
 
     mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
 
+#ifdef HAGL_HAL_USE_RGB444
+    if (mipi_display_is_rgb444(display_config)) {
+        mipi_display_rgb444_fill(display_config, *color, size);
+        return (size * 3 + 1) / 2;
+    }
+#endif /* HAGL_HAL_USE_RGB444 */
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_fill(display_config, *color, size);
+        return size * (display_config->depth / 8);
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
+#ifdef HAGL_HAL_USE_DMA
+    mipi_display_fill_data_dma(display_config, *color, size);
+#else
     /* Set DC high to denote incoming data. */
     gpio_put(display_config->pin_dc, 1);
 
     /* Set CS low to reserve the SPI bus. */
     gpio_put(display_config->pin_cs, 0);
 
+#ifdef HAGL_HAL_USE_COUNTERS
+    mipi_display_count_data(display_config, size * 2);
+#endif /* HAGL_HAL_USE_COUNTERS */
+#ifdef HAGL_HAL_USE_TRACE
+    mipi_display_trace(display_config, 1, (const uint8_t *) color, 2, size);
+#endif /* HAGL_HAL_USE_TRACE */
+
     /* TODO: This assumes 16 bit colors. */
     spi_set_format(display_config->spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
 
-    while (size--) {
+    uint16_t swapped = htons(*color);
+    for (size_t i = 0; i < size; i++) {
         while (!spi_is_writable(display_config->spi)) {};
-        spi_get_hw(display_config->spi)->dr = (uint32_t) htons(*color);
+        spi_get_hw(display_config->spi)->dr = (uint32_t) swapped;
     }
 
     /* Wait for shifting to finish. */
@@ -361,8 +1970,9 @@ mipi_display_fill_xywh(mipi_display_config_t *display_config, uint16_t x1, uint1
 
     /* Set CS high to ignore any traffic on SPI bus. */
     gpio_put(display_config->pin_cs, 1);
+#endif /* HAGL_HAL_USE_DMA */
 
-    return size;
+    return size * (display_config->depth / 8);
 }
 
 size_t
@@ -372,41 +1982,487 @@ mipi_display_write_xywh(mipi_display_config_t *display_config, uint16_t x1, uint
         return 0;
     }
 
+#ifdef HAGL_HAL_USE_SCROLL
+    uint16_t rows = mipi_display_scroll_rows(display_config, y1, h);
+    if (rows < h) {
+        /* Window wraps around in GRAM, send it in parts. */
+        size_t sent = mipi_display_write_xywh(display_config, x1, y1, w, rows, buffer);
+        buffer += w * rows * (display_config->depth / 8);
+        return sent + mipi_display_write_xywh(display_config, x1, y1 + rows, w, h - rows, buffer);
+    }
+#endif /* HAGL_HAL_USE_SCROLL */
+
     int32_t x2 = x1 + w - 1;
     int32_t y2 = y1 + h - 1;
     uint32_t size = w * h;
 
-#ifdef HAGL_HAL_USE_SINGLE_BUFFER
-    mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
-    mipi_display_write_data(display_config, buffer, size * display_config->depth / 8);
-#endif /* HAGL_HAL_SINGLE_BUFFER */
+#ifdef HAGL_HAL_USE_RGB444
+    if (mipi_display_is_rgb444(display_config)) {
+        mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
+        mipi_display_rgb444_write(display_config, buffer, size * 2);
+        mipi_display_rgb444_finish(display_config);
+        return (size * 3 + 1) / 2;
+    }
+#endif /* HAGL_HAL_USE_RGB444 */
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_write_xywh(display_config, x1, y1, x2, y2, buffer, size * display_config->depth / 8);
+        if (mipi_display_is_single_buffered(display_config)) {
+            mipi_display_pio_wait(display_config);
+        }
+        return size * (display_config->depth / 8);
+    }
+#endif /* HAGL_HAL_USE_PIO */
 
-#ifdef HAGL_HAS_HAL_BACK_BUFFER
     mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
 #ifdef HAGL_HAL_USE_DMA
     mipi_display_write_data_dma(display_config, buffer, size * display_config->depth / 8);
+    if (mipi_display_is_single_buffered(display_config)) {
+        /* Bitmap belongs to the caller who may change it after returning. */
+        mipi_display_dma_wait(display_config);
+    }
 #else
     mipi_display_write_data(display_config, buffer, size * display_config->depth / 8);
 #endif /* HAGL_HAL_USE_DMA */
-#endif /* HAGL_HAS_HAL_BACK_BUFFER */
     /* This should also include the bytes for writing the commands. */
     return size * (display_config->depth / 8);
 }
 
+size_t
+mipi_display_write_xywh_pitch(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch)
+{
+    if (0 == w || 0 == h) {
+        return 0;
+    }
+
+    size_t length = w * (display_config->depth / 8);
+
+#ifdef HAGL_HAL_USE_SCROLL
+    uint16_t rows = mipi_display_scroll_rows(display_config, y1, h);
+    if (rows < h) {
+        /* Window wraps around in GRAM, send it in parts. */
+        size_t sent = mipi_display_write_xywh_pitch(display_config, x1, y1, w, rows, buffer, pitch);
+        buffer += rows * pitch;
+        return sent + mipi_display_write_xywh_pitch(display_config, x1, y1 + rows, w, h - rows, buffer, pitch);
+    }
+#endif /* HAGL_HAL_USE_SCROLL */
+
+    /* Rows are contiguous, no need to send them one by one. */
+    if (length == pitch) {
+        return mipi_display_write_xywh(display_config, x1, y1, w, h, buffer);
+    }
+
+    int32_t x2 = x1 + w - 1;
+    int32_t y2 = y1 + h - 1;
+
+    mipi_display_set_address_xyxy(display_config, x1, y1, x2, y2);
+
+    /* Window is set only once, rows are streamed one after another. */
+    for (uint16_t y = 0; y < h; y++) {
+#ifdef HAGL_HAL_USE_RGB444
+        if (mipi_display_is_rgb444(display_config)) {
+            mipi_display_rgb444_write(display_config, buffer, length);
+            buffer += pitch;
+            continue;
+        }
+#endif /* HAGL_HAL_USE_RGB444 */
+#if defined(HAGL_HAS_HAL_BACK_BUFFER) && defined(HAGL_HAL_USE_DMA)
+        mipi_display_write_data_dma(display_config, buffer, length);
+#else
+        mipi_display_write_data(display_config, buffer, length);
+#endif /* HAGL_HAS_HAL_BACK_BUFFER && HAGL_HAL_USE_DMA */
+        buffer += pitch;
+    }
+
+#ifdef HAGL_HAL_USE_RGB444
+    if (mipi_display_is_rgb444(display_config)) {
+        mipi_display_rgb444_finish(display_config);
+        return (length * h * 3 / 2 + 1) / 2;
+    }
+#endif /* HAGL_HAL_USE_RGB444 */
+
+    /* This should also include the bytes for writing the commands. */
+    return length * h;
+}
+
+#if HAGL_HAL_PIXEL_SIZE > 1
+static inline void
+mipi_display_expand_line(hagl_color_t *line, const hagl_color_t *source, uint16_t w, uint8_t scale)
+{
+    switch (scale) {
+    case 2:
+        for (uint16_t x = 0; x < w; x++) {
+            hagl_color_t color = source[x];
+            line[0] = color;
+            line[1] = color;
+            line += 2;
+        }
+        break;
+    case 3:
+        for (uint16_t x = 0; x < w; x++) {
+            hagl_color_t color = source[x];
+            line[0] = color;
+            line[1] = color;
+            line[2] = color;
+            line += 3;
+        }
+        break;
+    default:
+        for (uint16_t x = 0; x < w; x++) {
+            hagl_color_t color = source[x];
+            for (uint8_t i = 0; i < scale; i++) {
+                *(line++) = color;
+            }
+        }
+        break;
+    }
+}
+
+/*
+ * Sends an area of a smaller buffer with each pixel repeated scale times
+ * in both directions. Coordinates are in buffer pixels. The whole area is
+ * one address window. Rows are expanded into the two line buffers in
+ * turns so that with DMA the next row is expanded while the previous one
+ * is being sent. Each expanded row is sent scale times.
+ */
+size_t
+mipi_display_write_xywh_scaled(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *buffer, size_t pitch, uint8_t scale)
+{
+    if (0 == w || 0 == h) {
+        return 0;
+    }
+
+    size_t length = w * scale * (display_config->depth / 8);
+    uint8_t current = 0;
+
+    mipi_display_start_xywh(display_config, x1 * scale, y1 * scale, w * scale, h * scale);
+
+    for (uint16_t y = 0; y < h; y++) {
+        hagl_color_t *line = display_config->line_buffer[current];
+
+        mipi_display_expand_line(line, (hagl_color_t *) buffer, w, scale);
+        for (uint8_t i = 0; i < scale; i++) {
+            mipi_display_write_stream(display_config, (uint8_t *) line, length);
+        }
+
+        current ^= 1;
+        buffer += pitch;
+    }
+
+    /* Line buffers are reused by the next call. */
+    mipi_display_sync(display_config);
+
+    /* This should also include the bytes for writing the commands. */
+    return length * h * scale;
+}
+#endif /* HAGL_HAL_PIXEL_SIZE > 1 */
+
+/*
+ * Sets the address window and starts memory write. Pixels are then sent
+ * with one or more calls to mipi_display_write_stream().
+ */
+void
+mipi_display_start_xywh(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint16_t w, uint16_t h)
+{
+    if (0 == w || 0 == h) {
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_SCROLL
+    /* Rows past the wrap in GRAM get their own window when streamed. */
+    uint16_t rows = mipi_display_scroll_rows(display_config, y1, h);
+    display_config->stream_x = x1;
+    display_config->stream_y = y1 + rows;
+    display_config->stream_w = w;
+    display_config->stream_h = h - rows;
+    display_config->stream_left = rows * w * sizeof(hagl_color_t);
+    h = rows;
+#endif /* HAGL_HAL_USE_SCROLL */
+
+    mipi_display_set_address_xyxy(display_config, x1, y1, x1 + w - 1, y1 + h - 1);
+}
+
+/*
+ * With DMA this returns while the buffer is still being sent. Next write
+ * waits for the previous one so two buffers can be filled in turns.
+ */
+size_t
+mipi_display_write_stream(mipi_display_config_t *display_config, const uint8_t *buffer, size_t length)
+{
+#ifdef HAGL_HAL_USE_SCROLL
+    if (display_config->stream_h && length > display_config->stream_left) {
+        /* Window wraps around in GRAM, continue the stream in a new one. */
+        size_t first = display_config->stream_left;
+        size_t sent = mipi_display_write_stream(display_config, buffer, first);
+        mipi_display_start_xywh(
+            display_config,
+            display_config->stream_x, display_config->stream_y,
+            display_config->stream_w, display_config->stream_h
+        );
+        return sent + mipi_display_write_stream(display_config, buffer + first, length - first);
+    }
+    display_config->stream_left -= length;
+#endif /* HAGL_HAL_USE_SCROLL */
+
+#ifdef HAGL_HAL_USE_RGB444
+    if (mipi_display_is_rgb444(display_config)) {
+        mipi_display_rgb444_write(display_config, buffer, length);
+        return length * 3 / 4;
+    }
+#endif /* HAGL_HAL_USE_RGB444 */
+
+#ifdef HAGL_HAL_USE_DMA
+    mipi_display_write_data_dma(display_config, buffer, length);
+#else
+    mipi_display_write_data(display_config, buffer, length);
+#endif /* HAGL_HAL_USE_DMA */
+
+    return length;
+}
+
+/* Wait until the buffers passed to mipi_display_write_stream() are free. */
+void
+mipi_display_sync(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_RGB444
+    mipi_display_rgb444_finish(display_config);
+#endif /* HAGL_HAL_USE_RGB444 */
+    mipi_display_dma_wait(display_config);
+}
+
+/*
+ * True while a transfer to this display is still running. Each display has
+ * its own channels so displays on different SPI blocks can be flushed in
+ * parallel and polled separately.
+ */
+bool
+mipi_display_busy(mipi_display_config_t *display_config)
+{
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        return dma_channel_is_busy(display_config->pio_dma_control)
+            || dma_channel_is_busy(display_config->pio_dma_data);
+    }
+#endif /* HAGL_HAL_USE_PIO */
+#ifdef HAGL_HAL_USE_SHARED_BUS
+    if (display_config->bus) {
+        /* Polling keeps the queued writes going. */
+        mipi_display_bus_dispatch(display_config->bus);
+        if (display_config->bus_pending) {
+            return true;
+        }
+    }
+#endif /* HAGL_HAL_USE_SHARED_BUS */
+#ifdef HAGL_HAL_USE_DMA
+    if (dma_channel_is_busy(display_config->dma_channel)) {
+        return true;
+    }
+#endif /* HAGL_HAL_USE_DMA */
+#ifdef HAGL_HAL_USE_MULTICORE
+    if (display_config->busy) {
+        return true;
+    }
+#endif /* HAGL_HAL_USE_MULTICORE */
+    return display_config->vblank_job != NULL;
+}
+
+#ifdef HAGL_HAL_USE_COUNTERS
+void
+mipi_display_counters(mipi_display_config_t *display_config, mipi_display_counters_t *counters)
+{
+    /* Interrupts update the counters too. */
+    uint32_t status = save_and_disable_interrupts();
+    *counters = display_config->counters;
+    restore_interrupts(status);
+}
+
+void
+mipi_display_counters_reset(mipi_display_config_t *display_config)
+{
+    uint32_t status = save_and_disable_interrupts();
+    memset(&display_config->counters, 0, sizeof(mipi_display_counters_t));
+    restore_interrupts(status);
+}
+
+void
+mipi_display_count_flush(mipi_display_config_t *display_config, uint64_t start)
+{
+    display_config->counters.flush_time += time_us_64() - start;
+    display_config->counters.frames++;
+}
+
+/*
+ * Simple cost model: every byte takes eight bit times and every command
+ * adds the CS and DC toggling around it. Comparing this to the measured
+ * times tells how much of the time the bus was actually busy.
+ */
+uint64_t
+mipi_display_counters_wire_time(mipi_display_config_t *display_config, const mipi_display_counters_t *counters)
+{
+#ifdef HAGL_HAL_USE_PIO
+    uint32_t baud = mipi_display_is_pio(display_config)
+        ? display_config->spi_freq
+        : spi_get_baudrate(display_config->spi);
+#else
+    uint32_t baud = spi_get_baudrate(display_config->spi);
+#endif /* HAGL_HAL_USE_PIO */
+
+    uint64_t bits = (counters->pixel_bytes + counters->command_bytes) * 8;
+    return bits * 1000000 / baud + (uint64_t) counters->commands * MIPI_DISPLAY_MODEL_COMMAND_NS / 1000;
+}
+
+void
+mipi_display_counters_print(mipi_display_config_t *display_config, const mipi_display_counters_t *counters, const char *name, uint8_t format)
+{
+    /* Header row only, JSON lines do not have one. */
+    if (NULL == name || NULL == counters) {
+        if (MIPI_DISPLAY_COUNTERS_CSV == format) {
+            printf(
+                "name,pixel_bytes,command_bytes,commands,window_changes,window_hits,frames,"
+                "flush_time,te_wait_time,dma_stall_time,wire_time\n"
+            );
+        }
+        return;
+    }
+
+    uint64_t wire_time = mipi_display_counters_wire_time(display_config, counters);
+
+    if (MIPI_DISPLAY_COUNTERS_JSON == format) {
+        printf(
+            "{\"name\": \"%s\", \"pixel_bytes\": %llu, \"command_bytes\": %llu, \"commands\": %lu, "
+            "\"window_changes\": %lu, \"window_hits\": %lu, \"frames\": %lu, "
+            "\"flush_time\": %llu, \"te_wait_time\": %llu, \"dma_stall_time\": %llu, "
+            "\"wire_time\": %llu}\n",
+            name,
+            (unsigned long long) counters->pixel_bytes, (unsigned long long) counters->command_bytes,
+            (unsigned long) counters->commands,
+            (unsigned long) counters->window_changes, (unsigned long) counters->window_hits,
+            (unsigned long) counters->frames,
+            (unsigned long long) counters->flush_time, (unsigned long long) counters->te_wait_time,
+            (unsigned long long) counters->dma_stall_time, (unsigned long long) wire_time
+        );
+        return;
+    }
+
+    printf(
+        "%s,%llu,%llu,%lu,%lu,%lu,%lu,%llu,%llu,%llu,%llu\n",
+        name,
+        (unsigned long long) counters->pixel_bytes, (unsigned long long) counters->command_bytes,
+        (unsigned long) counters->commands,
+        (unsigned long) counters->window_changes, (unsigned long) counters->window_hits,
+        (unsigned long) counters->frames,
+        (unsigned long long) counters->flush_time, (unsigned long long) counters->te_wait_time,
+        (unsigned long long) counters->dma_stall_time, (unsigned long long) wire_time
+    );
+}
+#endif /* HAGL_HAL_USE_COUNTERS */
+
+#ifdef HAGL_HAL_USE_LOW_POWER
+void
+mipi_display_power_mode(mipi_display_config_t *display_config, uint8_t mode, const hagl_window_t *area)
+{
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+    mipi_display_power_set(display_config, mode, area);
+}
+
+void
+mipi_display_power_time(mipi_display_config_t *display_config, uint64_t *time)
+{
+    uint64_t now = time_us_64();
+
+    for (uint8_t i = 0; i < MIPI_DISPLAY_POWER_MODES; i++) {
+        time[i] = display_config->power_time[i];
+    }
+    /* Include the time spent in the current mode so far. */
+    time[display_config->power_mode] += now - display_config->power_since;
+}
+#endif /* HAGL_HAL_USE_LOW_POWER */
+
+#ifdef HAGL_HAL_USE_SCROLL
+/*
+ * Set the fixed areas at the top and bottom of the display. Rest of the
+ * display is the vertical scrolling area. Also resets the scroll offset.
+ * Areas which leave no lines to scroll are ignored.
+ */
+void
+mipi_display_scroll_area(mipi_display_config_t *display_config, uint16_t top, uint16_t bottom)
+{
+    uint16_t gram_height = display_config->gram_height ? display_config->gram_height : display_config->height;
+
+    /* Fixed areas must leave room for scrolling and fit into display memory. */
+    if ((uint32_t) top + bottom >= display_config->height ||
+        (uint32_t) display_config->offset_y + display_config->height - bottom > gram_height) {
+        hagl_hal_debug("Scroll area %d, %d does not fit the display, ignoring.\n", top, bottom);
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+    mipi_display_scroll_area_send(display_config, top, bottom);
+}
+
+/*
+ * Scroll the contents of the scrolling area up by given number of lines,
+ * down if negative. Only the scroll start address is sent. Rows exposed
+ * at the bottom, or top when scrolling down, must be redrawn.
+ */
+void
+mipi_display_scroll(mipi_display_config_t *display_config, int16_t lines)
+{
+    int32_t vsa = display_config->height - display_config->scroll_top - display_config->scroll_bottom;
+
+    if (vsa <= 0) {
+        return;
+    }
+
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+    int32_t offset = (display_config->scroll_offset + lines) % vsa;
+    if (offset < 0) {
+        offset += vsa;
+    }
+    display_config->scroll_offset = offset;
+
+    uint16_t start = display_config->scroll_top + offset + display_config->offset_y;
+    mipi_display_write_command(display_config, MIPI_DCS_SET_SCROLL_START);
+    mipi_display_write_data(display_config, (uint8_t[]) {start >> 8, start & 0xff}, 2);
+}
+#endif /* HAGL_HAL_USE_SCROLL */
+
 size_t
 mipi_display_write_xy(mipi_display_config_t *display_config, uint16_t x1, uint16_t y1, uint8_t *buffer)
 {
     mipi_display_set_address_xy(display_config, x1, y1);
+
+#ifdef HAGL_HAL_USE_RGB444
+    if (mipi_display_is_rgb444(display_config)) {
+        mipi_display_rgb444_write(display_config, buffer, 2);
+        mipi_display_rgb444_finish(display_config);
+        return 2;
+    }
+#endif /* HAGL_HAL_USE_RGB444 */
+
     mipi_display_write_data(display_config, buffer, display_config->depth / 8);
 
     /* This should also include the bytes for writing the commands. */
     return display_config->depth / 8;
 }
 
-/* TODO: This most likely does not work with dma atm. */
 void
 mipi_display_ioctl(mipi_display_config_t *display_config, const uint8_t command, uint8_t *data, size_t size)
 {
+#ifdef HAGL_HAL_USE_MULTICORE
+    /* Do not interleave with a transfer running on core 1. */
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
     switch (command) {
         case MIPI_DCS_GET_COMPRESSION_MODE:
         case MIPI_DCS_GET_DISPLAY_ID:
@@ -426,8 +2482,7 @@ mipi_display_ioctl(mipi_display_config_t *display_config, const uint8_t command,
         case MIPI_DCS_GET_POWER_SAVE:
         case MIPI_DCS_READ_DDB_START:
         case MIPI_DCS_READ_DDB_CONTINUE:
-            mipi_display_write_command(display_config, command);
-            mipi_display_read_data(display_config, data, size);
+            mipi_display_read_command(display_config, command, data, size);
             break;
         default:
             mipi_display_write_command(display_config, command);
@@ -438,5 +2493,17 @@ mipi_display_ioctl(mipi_display_config_t *display_config, const uint8_t command,
 void
 mipi_display_close(mipi_display_config_t *display_config)
 {
+#ifdef HAGL_HAL_USE_MULTICORE
+    mipi_display_wait(display_config);
+#endif /* HAGL_HAL_USE_MULTICORE */
+
+#ifdef HAGL_HAL_USE_PIO
+    if (mipi_display_is_pio(display_config)) {
+        mipi_display_pio_wait_idle(display_config);
+        pio_sm_set_enabled(display_config->pio, display_config->pio_sm, false);
+        return;
+    }
+#endif /* HAGL_HAL_USE_PIO */
+
     spi_deinit(display_config->spi);
 }
\ No newline at end of file
@@ -0,0 +1,340 @@
+/*
+
+MIT License
+
+Copyright (c) 2023 Mika Tuupola
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-cut-
+
+This file is part of the Raspberry Pi Pico MIPI DCS backend for the HAGL
+graphics library: https://github.com/tuupola/hagl_pico_mipi
+
+SPDX-License-Identifier: MIT
+
+-cut-
+
+Decoder for the command and data stream sent to the display. Pixels are
+written to the GRAM image in controller address space. Address mode is
+tracked but not applied, the image is what the controller stores, not
+what the panel shows. Scroll start does not move anything in GRAM, it is
+applied when the image is copied out with mipi_display_trace_screen().
+
+*/
+
+#include <string.h>
+
+#include "mipi_dcs.h"
+#include "mipi_display_trace.h"
+
+/* Number of parameters of the commands which change the tracked state. */
+static uint8_t
+mipi_display_trace_params(uint8_t command)
+{
+    switch (command) {
+    case MIPI_DCS_SET_SCROLL_AREA:
+        return 6;
+    case MIPI_DCS_SET_COLUMN_ADDRESS:
+    case MIPI_DCS_SET_PAGE_ADDRESS:
+        return 4;
+    case MIPI_DCS_SET_SCROLL_START:
+        return 2;
+    case MIPI_DCS_SET_ADDRESS_MODE:
+    case MIPI_DCS_SET_PIXEL_FORMAT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static inline uint16_t
+mipi_display_trace_word(const uint8_t *params, uint8_t index)
+{
+    return (uint16_t) params[index * 2] << 8 | params[index * 2 + 1];
+}
+
+/* Returns true if the command did not change anything. */
+static bool
+mipi_display_trace_apply(mipi_display_trace_t *trace)
+{
+    const uint8_t *params = trace->params;
+    uint16_t a = mipi_display_trace_word(params, 0);
+    uint16_t b = mipi_display_trace_word(params, 1);
+    uint16_t c = mipi_display_trace_word(params, 2);
+    uint8_t known = 0;
+    bool same = false;
+
+    switch (trace->command) {
+    case MIPI_DCS_SET_COLUMN_ADDRESS:
+        known = MIPI_DISPLAY_TRACE_KNOWN_COLUMN;
+        same = trace->x0 == a && trace->x1 == b;
+        trace->x0 = a;
+        trace->x1 = b;
+        break;
+    case MIPI_DCS_SET_PAGE_ADDRESS:
+        known = MIPI_DISPLAY_TRACE_KNOWN_PAGE;
+        same = trace->y0 == a && trace->y1 == b;
+        trace->y0 = a;
+        trace->y1 = b;
+        break;
+    case MIPI_DCS_SET_ADDRESS_MODE:
+        known = MIPI_DISPLAY_TRACE_KNOWN_ADDRESS_MODE;
+        same = trace->address_mode == params[0];
+        trace->address_mode = params[0];
+        break;
+    case MIPI_DCS_SET_PIXEL_FORMAT:
+        known = MIPI_DISPLAY_TRACE_KNOWN_PIXEL_FORMAT;
+        same = trace->pixel_format == params[0];
+        trace->pixel_format = params[0];
+        break;
+    case MIPI_DCS_SET_SCROLL_AREA:
+        known = MIPI_DISPLAY_TRACE_KNOWN_SCROLL_AREA;
+        same = trace->scroll_top == a && trace->scroll_height == b && trace->scroll_bottom == c;
+        trace->scroll_top = a;
+        trace->scroll_height = b;
+        trace->scroll_bottom = c;
+        break;
+    case MIPI_DCS_SET_SCROLL_START:
+        known = MIPI_DISPLAY_TRACE_KNOWN_SCROLL_START;
+        same = trace->scroll_start == a;
+        trace->scroll_start = a;
+        break;
+    }
+
+    same = same && (trace->known & known);
+    trace->known |= known;
+
+    /* Previous address which no memory write used was wasted. */
+    if (!same && (known & (MIPI_DISPLAY_TRACE_KNOWN_COLUMN | MIPI_DISPLAY_TRACE_KNOWN_PAGE))) {
+        if (trace->pending & known) {
+            trace->stats.overwritten_commands++;
+            trace->stats.overwritten_bytes += 5;
+        }
+        trace->pending |= known;
+    }
+
+    return same;
+}
+
+/* Store pixel and advance the write pointer, wrapping inside the window. */
+static void
+mipi_display_trace_pixel(mipi_display_trace_t *trace, uint16_t color)
+{
+    trace->stats.pixels++;
+    trace->written++;
+
+    if (trace->gram && trace->x < trace->gram_width && trace->y < trace->gram_height) {
+        trace->gram[(size_t) trace->y * trace->gram_width + trace->x] = color;
+    } else {
+        trace->stats.pixels_clipped++;
+    }
+
+    if (trace->x < trace->x1) {
+        trace->x++;
+    } else {
+        trace->x = trace->x0;
+        trace->y = trace->y < trace->y1 ? trace->y + 1 : trace->y0;
+    }
+}
+
+/* Pixels are always stored as RGB565. */
+static void
+mipi_display_trace_pixel_byte(mipi_display_trace_t *trace, uint8_t byte)
+{
+    uint8_t *pixel = trace->pixel;
+
+    trace->stats.pixel_bytes++;
+    pixel[trace->pixel_count++] = byte;
+
+    switch (trace->pixel_format & 0x07) {
+    case MIPI_DCS_PIXEL_FORMAT_12BIT & 0x07:
+        /* Two pixels in three bytes. */
+        if (2 == trace->pixel_count) {
+            uint8_t r = pixel[0] >> 4, g = pixel[0] & 0x0f, b = pixel[1] >> 4;
+            mipi_display_trace_pixel(trace, (r << 12) | (r >> 3) << 11 | (g << 7) | (g >> 2) << 5 | (b << 1) | (b >> 3));
+        } else if (3 == trace->pixel_count) {
+            uint8_t r = pixel[1] & 0x0f, g = pixel[2] >> 4, b = pixel[2] & 0x0f;
+            mipi_display_trace_pixel(trace, (r << 12) | (r >> 3) << 11 | (g << 7) | (g >> 2) << 5 | (b << 1) | (b >> 3));
+            trace->pixel_count = 0;
+        }
+        break;
+    case MIPI_DCS_PIXEL_FORMAT_18BIT & 0x07:
+        if (3 == trace->pixel_count) {
+            mipi_display_trace_pixel(trace, (pixel[0] >> 3) << 11 | (pixel[1] >> 2) << 5 | (pixel[2] >> 3));
+            trace->pixel_count = 0;
+        }
+        break;
+    default:
+        /* Controllers start in 16 bit mode. */
+        if (2 == trace->pixel_count) {
+            mipi_display_trace_pixel(trace, (uint16_t) pixel[0] << 8 | pixel[1]);
+            trace->pixel_count = 0;
+        }
+        break;
+    }
+}
+
+/* Account for the memory write which the next command ends. */
+static void
+mipi_display_trace_end(mipi_display_trace_t *trace)
+{
+    if (!trace->writing) {
+        return;
+    }
+
+    if (0 == trace->written) {
+        trace->stats.empty_writes++;
+    }
+
+    /* Leftover bytes which did not complete a pixel. */
+    if (1 == trace->pixel_count || (2 == trace->pixel_count && (trace->pixel_format & 0x07) != (MIPI_DCS_PIXEL_FORMAT_12BIT & 0x07))) {
+        trace->stats.partial_bytes += trace->pixel_count;
+    }
+
+    trace->writing = false;
+    trace->pixel_count = 0;
+}
+
+static void
+mipi_display_trace_command(mipi_display_trace_t *trace, uint8_t command)
+{
+    mipi_display_trace_end(trace);
+
+    trace->stats.commands++;
+    trace->stats.command_bytes++;
+    trace->command = command;
+    trace->param_count = 0;
+
+    if (MIPI_DCS_WRITE_MEMORY_START == command) {
+        trace->x = trace->x0;
+        trace->y = trace->y0;
+    }
+
+    if (MIPI_DCS_WRITE_MEMORY_START == command || MIPI_DCS_WRITE_MEMORY_CONTINUE == command) {
+        trace->writing = true;
+        trace->written = 0;
+        trace->pending = 0;
+    }
+}
+
+static void
+mipi_display_trace_param(mipi_display_trace_t *trace, uint8_t byte)
+{
+    uint8_t count = mipi_display_trace_params(trace->command);
+
+    trace->stats.command_bytes++;
+
+    if (trace->param_count < sizeof(trace->params)) {
+        trace->params[trace->param_count] = byte;
+    }
+    trace->param_count++;
+
+    if (count && count == trace->param_count) {
+        if (mipi_display_trace_apply(trace)) {
+            trace->stats.redundant_commands++;
+            trace->stats.redundant_bytes += 1 + count;
+        }
+    }
+}
+
+void
+mipi_display_trace_init(mipi_display_trace_t *trace, uint16_t *gram, uint16_t width, uint16_t height)
+{
+    memset(trace, 0, sizeof(mipi_display_trace_t));
+
+    trace->gram = gram;
+    trace->gram_width = width;
+    trace->gram_height = height;
+    trace->pixel_format = MIPI_DCS_PIXEL_FORMAT_16BIT;
+}
+
+void
+mipi_display_trace_feed(mipi_display_trace_t *trace, uint8_t dc, const uint8_t *data, size_t length, size_t repeat)
+{
+    while (repeat--) {
+        for (size_t i = 0; i < length; i++) {
+            if (0 == dc) {
+                mipi_display_trace_command(trace, data[i]);
+            } else if (trace->writing) {
+                mipi_display_trace_pixel_byte(trace, data[i]);
+            } else {
+                mipi_display_trace_param(trace, data[i]);
+            }
+        }
+    }
+}
+
+void
+mipi_display_trace_hook(uint8_t dc, const uint8_t *data, size_t length, size_t repeat, void *trace)
+{
+    mipi_display_trace_feed((mipi_display_trace_t *) trace, dc, data, length, repeat);
+}
+
+void
+mipi_display_trace_reset(mipi_display_trace_t *trace)
+{
+    memset(&trace->stats, 0, sizeof(mipi_display_trace_stats_t));
+}
+
+/*
+ * Scroll start is the GRAM line shown on the first line of the scroll
+ * area. Lines of the scroll area below it wrap around inside the area.
+ */
+void
+mipi_display_trace_screen(const mipi_display_trace_t *trace, uint16_t *screen)
+{
+    uint16_t top = 0;
+    uint16_t height = trace->gram_height;
+    uint16_t start = 0;
+
+    if (!trace->gram) {
+        return;
+    }
+
+    if (trace->known & MIPI_DISPLAY_TRACE_KNOWN_SCROLL_AREA) {
+        top = trace->scroll_top;
+        height = trace->scroll_height;
+    }
+    if (trace->known & MIPI_DISPLAY_TRACE_KNOWN_SCROLL_START) {
+        start = trace->scroll_start;
+    }
+
+    /* Start outside of the scroll area is ignored like the controller does. */
+    if (start < top || start >= top + height) {
+        start = top;
+    }
+
+    for (uint16_t y = 0; y < trace->gram_height; y++) {
+        uint16_t line = y;
+
+        if (y >= top && y < top + height) {
+            line = top + (y - top + start - top) % height;
+        }
+        if (line >= trace->gram_height) {
+            line = y;
+        }
+
+        memcpy(
+            &screen[(size_t) y * trace->gram_width],
+            &trace->gram[(size_t) line * trace->gram_width],
+            trace->gram_width * sizeof(uint16_t)
+        );
+    }
+}